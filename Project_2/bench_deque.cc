@@ -0,0 +1,100 @@
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "deque.h"
+
+// Usage: bench_deque [num_items]
+// Times Deque against std::deque, reporting nanoseconds per operation:
+// pushes at the back and at the front, random access with operator[],
+// a queue that keeps pushing at the back and popping at the front (so
+// that positions wrap around), and pops at the back.
+
+typedef std::chrono::steady_clock Clock;
+
+// Minimal Deque API over std::deque
+class StdDeque : public std::deque<int> {
+ public:
+    void PushBack(int value) {
+        push_back(value);
+    }
+    void PushFront(int value) {
+        push_front(value);
+    }
+    void PopFront() {
+        pop_front();
+    }
+    void PopBack() {
+        pop_back();
+    }
+    int& Front() {
+        return front();
+    }
+};
+
+static double NsPerOp(Clock::time_point start, size_t ops) {
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+template <typename D>
+static long Bench(const std::string& name, size_t num_items,
+        const std::vector<size_t>& positions) {
+    long sum = 0;
+    D dq;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < num_items; i++)
+        dq.PushBack(i);
+    double push_back_ns = NsPerOp(start, num_items);
+
+    start = Clock::now();
+    for (size_t i = 0; i < num_items; i++)
+        dq.PushFront(i);
+    double push_front_ns = NsPerOp(start, num_items);
+
+    start = Clock::now();
+    for (size_t pos : positions)
+        sum += dq[pos];
+    double index_ns = NsPerOp(start, positions.size());
+
+    // The queue keeps its size, so it never resizes
+    start = Clock::now();
+    for (size_t i = 0; i < num_items; i++) {
+        sum += dq.Front();
+        dq.PopFront();
+        dq.PushBack(i);
+    }
+    double queue_ns = NsPerOp(start, num_items);
+
+    start = Clock::now();
+    for (size_t i = 0; i < 2 * num_items; i++)
+        dq.PopBack();
+    double pop_back_ns = NsPerOp(start, 2 * num_items);
+
+    std::cout << name << "\tpush_back " << push_back_ns << "\tpush_front "
+        << push_front_ns << "\t[] " << index_ns << "\tqueue " << queue_ns
+        << "\tpop_back " << pop_back_ns << " ns/op" << std::endl;
+    return sum;
+}
+
+int main(int argc, char* argv[]) {
+    size_t num_items = argc > 1 ? std::strtoul(argv[1], nullptr, 10) :
+        1000000;
+    if (num_items == 0)
+        num_items = 1;
+    // Random positions among the 2 * num_items items
+    std::mt19937 random(42);
+    std::vector<size_t> positions(num_items);
+    for (size_t& pos : positions)
+        pos = random() % (2 * num_items);
+
+    long sum = 0;
+    sum += Bench<Deque<int>>("Deque", num_items, positions);
+    sum += Bench<StdDeque>("std::deque", num_items, positions);
+    // Keeps the reads from being optimized away
+    if (sum == 42)
+        std::cout << std::endl;
+}
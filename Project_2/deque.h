@@ -43,12 +43,11 @@ class Deque {
     size_t Size() const noexcept {
         return cur_size;
     }
-    // Resize internal data structure to fit precisely
-    // the number of items and free unused memory
+    // Resize internal data structure to fit the number of items, rounded
+    // up to a power of two, and free unused memory
     // Complexity: O(N)
     void ShrinkToFit() {
-        int size = cur_size;
-        Resize(size);
+        Resize(cur_size);
     }
     //
     // Element access
@@ -60,10 +59,9 @@ class Deque {
         if (pos >= cur_size) {
             throw std::out_of_range("Out of range!");
         } else {
-            // Recieves potition in memory and returns
-            // position in deque by adding from head
-            // and accounting for the edge case
-            return items[(front + pos) % capacity];
+            // Position in memory is counted from the front, wrapping
+            // around the end of the array
+            return items[(front + pos) & (capacity - 1)];
         }
     }
     // Return item at front of deque
@@ -74,7 +72,7 @@ class Deque {
     // Return item at back of deque
     // Complexity: O(1)
     T& Back() {
-        return items[back];
+        return items[(front + cur_size - 1) & (capacity - 1)];
     }
     //
     // Modifiers
@@ -83,8 +81,7 @@ class Deque {
     // Clear contents of deque (make it empty)
     // Complexity: O(1)
     void Clear(void) noexcept {
-        front = -1;
-        back = -1;
+        front = 0;
         cur_size = 0;
     }
 
@@ -96,25 +93,9 @@ class Deque {
         if (capacity == cur_size) {
             Resize(capacity * 2);
         }
-        int cap = capacity;
-        // If empty, move both front and back to point
-        // to the only item in the array (from -1 to 0)
-        if (Empty()) {
-            front = 0;
-            back = 0;
-        // Otherwise if front is anywhere from 1 to cap
-        // front is decremented to move to the left
-        } else if (front > 0) {
-            front--;
-        // Otherwise front is at zero and must be moved
-        // to the rightmost position in capacity
-        } else if (front == 0) {
-            front = cap - 1;
-        } else {
-            throw std::out_of_range("Out of range!");
-        }
-        // Value inserted at new position and current
-        // size is updated accordingly
+        // Front moves one to the left, from 0 to the rightmost position
+        // (unsigned wraparound, then the mask)
+        front = (front - 1) & (capacity - 1);
         items[front] = value;
         cur_size++;
     }
@@ -126,89 +107,38 @@ class Deque {
         if (capacity == cur_size) {
             Resize(capacity * 2);
         }
-        int cap = capacity;
-        // If empty, move both front and back to point
-        // to the only item in the array (from -1 to 0)
-        if (Empty()) {
-            front = 0;
-            back = 0;
-        // Otherwise if back is between 0 and cap
-        // back is incremented to move to the right
-        } else if (back < cap) {
-            back++;
-        // Otherwise, back is at cap and must be moved to
-        // the leftmost position in capacity at position 0
-        } else {
-            back = 0;
-        }
-        // Value inserted at new position and current
-        // size is updated accordingly
-        items[back] = value;
+        // The item goes right after the back, from the rightmost
+        // position to 0
+        items[(front + cur_size) & (capacity - 1)] = value;
         cur_size++;
     }
     // Remove item at front of deque
     // Complexity: O(1) amortized
     // Travels Right
     void PopFront() {
-        int cap = capacity;
         // If deque is empty, nothing can be popped so
         // out_of_range is thrown
         if (Empty()) {
             throw std::out_of_range("Deque Empty!");
-        // If back and front are equal, they are pointing to
-        // the only item in the deque, so popping the item
-        // would make the deque empty, and reset the front and back
-        } else if (back == front) {
-            front = -1;
-            back = -1;
-        // Otherwise if front is greater than zero and not
-        // at cap, front is incremented to the right
-        } else if (front < cap - 1 && front >= 0) {
-            front++;
-        // Otherwise, front is at the cap and must be moved to
-        // the leftmost position in capacity at position 0
-        } else {
-            front = 0;
         }
-        // Current size is updated accordingly
+        // Front moves one to the right, from the rightmost position to 0
+        front = (front + 1) & (capacity - 1);
         cur_size--;
-        // deque shrinks dynamically if current size
-        // is a quarter of the allocated memory
-        if (cur_size < capacity / 4) {
-            Resize(capacity / 2);
-        }
+        Shrink();
     }
     // Remove item at back of deque
     // Complexity: O(1) amortized
     // Travels Left
     void PopBack() {
-        int cap = capacity;
         // If deque is empty, nothing can be popped so
         // out_of_range is thrown
         if (Empty()) {
             throw std::out_of_range("Deque Empty!");
-        // If back and front are equal, they are pointing to
-        // the only item in the deque, so popping the item
-        // would make the deque empty, and reset the front and back
-        } else if (back == front) {
-            front = -1;
-            back = -1;
-        // Otherwise if back is greater than zero and within range
-        // back is decremented to the left
-        } else if (back > 0 && back < cap) {
-            back--;
-        // Otherwise if back is at the left side, it must
-        // be moved to the rightmost position in capacity
-        } else {
-            back = cap - 1;
         }
-        // Current size is updated accordingly
+        // The back is found from the front and size, so only the size
+        // changes
         cur_size--;
-        // deque shrinks dynamically if current size
-        // is a quarter of the allocated memory
-        if (cur_size < capacity / 4) {
-            Resize(capacity / 2);
-        }
+        Shrink();
     }
 
  private:
@@ -216,58 +146,49 @@ class Deque {
     // @@@ The class's internal members below can be modified @@@
     //
 
+    // Private constants
+    // Capacities are powers of two, so that positions wrap around the end
+    // of the array with a mask (capacity - 1) instead of a modulo
+    static const size_t kMinCapacity = 4;
+
     // Private member variables
-    // Initial capacity of 3 items
-    size_t capacity = 3;
+    size_t capacity = kMinCapacity;
     std::unique_ptr<T[]> items;
     size_t cur_size = 0;
-
-    int front = -1;
-    int back = -1;
-
-    // Private constants
-    // ...To be completed (if any)...
+    // Position of the front item in memory; the back is at
+    // front + cur_size - 1, wrapped
+    size_t front = 0;
 
     // Private methods
-    // ...To be completed (if any)...
+    // deque shrinks dynamically if current size
+    // is a quarter of the allocated memory
+    void Shrink() {
+        if (cur_size < capacity / 4 && capacity > kMinCapacity) {
+            Resize(capacity / 2);
+        }
+    }
+    // Moves the items to an array of at least @new_cap items, rounded up
+    // to a power of two, with the front at position 0
     void Resize(size_t new_cap) {
-        assert(new_cap && new_cap >= cur_size);
-        // If the deque is contiguous
-        if (back > front) {
-            std::unique_ptr<T[]> new_items(new T[new_cap]);
-            // Move will take an amount of elements from the first
-            // argument (the beginning of items[]), to the second
-            // (the end of items[]), and move the contents into
-            // the third argument (a new deque of twice the size)
-            std::move(std::next(items.get(), front),
-                std::next(items.get(), back + 1),
-                new_items.get());
-            // Ownership of the unique pointer deques are swapped
-            std::swap(items, new_items);
-            // Capacity, front, and back are reset
-            capacity = new_cap;
-            front = 0;
-            back = cur_size - 1;
-        } else {
-            // Otherwise, if the deque is nonontiguous
-            std::unique_ptr<T[]> new_items(new T[new_cap]);
-            // The portion on the right side is moved to
-            // the front of the new deque
-            std::move(std::next(items.get(), front),
-                std::next(items.get(), capacity),
-                new_items.get());
-            // The portion on the left side is moved behind
-            // the right portion within the new deque
-            std::move(std::next(items.get(), 0),
-                std::next(items.get(), back + 1),
-                std::next(new_items.get(), capacity - front));
-            // Ownership of the unique pointer deques are swapped
-            std::swap(items, new_items);
-            // Capacity, front, and back are reset
-            capacity = new_cap;
-            front = 0;
-            back = cur_size - 1;
+        assert(new_cap >= cur_size);
+        size_t cap = kMinCapacity;
+        while (cap < new_cap) {
+            cap *= 2;
         }
+        std::unique_ptr<T[]> new_items(new T[cap]);
+        // The items run from the front to the end of the array, then
+        // wrap around from position 0 if the deque is noncontiguous
+        size_t first = std::min(cur_size, capacity - front);
+        std::move(std::next(items.get(), front),
+            std::next(items.get(), front + first),
+            new_items.get());
+        std::move(items.get(), std::next(items.get(), cur_size - first),
+            std::next(new_items.get(), first));
+        // Ownership of the unique pointer deques are swapped
+        std::swap(items, new_items);
+        // Capacity and front are reset
+        capacity = cap;
+        front = 0;
     }
 };
 //
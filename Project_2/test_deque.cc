@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
+#include <deque>
 #include <iostream>
+#include <random>
 #include "deque.h"
 
 // Bradley Manzo
@@ -151,6 +153,52 @@ TEST(Deque, FrontBackTest) {
 	EXPECT_EQ(dq.Back(), 3);
 }
 
+TEST(Deque, WrapAround) {
+	Deque<int> dq;
+	std::deque<int> expected;
+	std::mt19937 random(42);
+
+	/* Random pushes and pops from both ends, so that the items wrap */
+	/* around the end of the array while it grows and shrinks */
+	for (int i = 0; i < 20000; i++) {
+		int op = random() % 5;
+		if (op == 0 || (op == 4 && i < 10000)) {
+			dq.PushFront(i);
+			expected.push_front(i);
+		} else if (op == 1) {
+			dq.PushBack(i);
+			expected.push_back(i);
+		} else if (op == 2 && !expected.empty()) {
+			dq.PopFront();
+			expected.pop_front();
+		} else if (!expected.empty()) {
+			dq.PopBack();
+			expected.pop_back();
+		}
+		ASSERT_EQ(dq.Size(), expected.size());
+		if (!expected.empty()) {
+			ASSERT_EQ(dq.Front(), expected.front());
+			ASSERT_EQ(dq.Back(), expected.back());
+			size_t pos = random() % expected.size();
+			ASSERT_EQ(dq[pos], expected[pos]);
+		}
+		if (i % 1000 == 0) {
+			dq.ShrinkToFit();
+		}
+	}
+	for (size_t pos = 0; pos < expected.size(); pos++)
+		EXPECT_EQ(dq[pos], expected[pos]);
+	EXPECT_THROW(dq[expected.size()], std::out_of_range);
+
+	/* Emptied and shrunk, then used again */
+	dq.Clear();
+	dq.ShrinkToFit();
+	EXPECT_THROW(dq.PopBack(), std::exception);
+	dq.PushFront(7);
+	EXPECT_EQ(dq.Front(), 7);
+	EXPECT_EQ(dq.Back(), 7);
+}
+
 int main(int argc, char* argv[]) {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
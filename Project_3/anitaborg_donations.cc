@@ -1,165 +1,759 @@
-#ifndef ANITABORG_CC_
-#define ANITABORG_CC_
-
-#include <algorithm>
-#include <cstddef>
-#include <exception>
-#include <fstream>
-#include <iostream>
-#include <memory>
-#include <queue>
-#include <sstream>
-#include <stack>
-#include <string>
-#include <utility>
-#include "treemap.h"
-
-// all: prints all the donors by increasing order of donations
-void All(Treemap<int, std::string>& donor_tree) {
-    int floor = donor_tree.MinKey();
-    int size = donor_tree.Size();
-    // Prints cheapest donor
-    std::cout << donor_tree.Get(donor_tree.MinKey())
-        << " (" << donor_tree.MinKey() << ")" << std::endl;
-    // For every donor in file, ceiling of prev donor
-    // key + 1 returns the next highest donor
-    for (int i = 0; i < size - 1; i++) {
-        std::cout << donor_tree.Get(donor_tree.CeilKey(floor + 1))
-            << " (" << donor_tree.CeilKey(floor + 1) << ")" << std::endl;
-        // floor is adjusted to the current donor key + 1
-        floor = donor_tree.CeilKey(floor + 1);
-    }
-}
-// rich : prints the donor who donated the largest amount
-void Rich(Treemap<int, std::string>& donor_tree) {
-    std::cout << donor_tree.Get(donor_tree.MaxKey())
-        << " (" << donor_tree.MaxKey() << ")" << std::endl;
-}
-// cheap : prints the donor who donated the smallest amount
-void Cheap(Treemap<int, std::string>& donor_tree) {
-    std::cout << donor_tree.Get(donor_tree.MinKey())
-        << " (" << donor_tree.MinKey() << ")" << std::endl;
-}
-// who amount : prints the donor who donated amount, if any
-
-void Who_Amount(Treemap<int, std::string>& donor_tree, int key) {
-    std::cout << donor_tree.Get(key) << " ("
-        << key << ")" << std::endl;
-}
-// who + amount : prints the first donor who donated more than amount, if any
-
-void Who_Plus_Amount(Treemap<int, std::string>& donor_tree, int key) {
-    if (donor_tree.ContainsKey(key)) {
-        std::cout << donor_tree.Get(donor_tree.CeilKey(key + 1))
-            << " (" << donor_tree.CeilKey(key + 1) << ")" << std::endl;
-    } else {
-        std::cout << "No match" << std::endl;
-    }
-}
-// who - amount : prints the first donor who donated less than amount, if any
-void Who_Minus_Amount(Treemap<int, std::string>& donor_tree, int key) {
-    if (donor_tree.ContainsKey(key)) {
-        std::cout << donor_tree.Get(donor_tree.FloorKey(key - 1))
-            << " (" << donor_tree.FloorKey(key - 1)
-            << ")" << std::endl;
-    } else {
-        std::cout << "No match" << std::endl;
-    }
-    std::cout << donor_tree.Get(donor_tree.FloorKey(key - 1))
-        << " (" << donor_tree.FloorKey(key - 1) << ")" << std::endl;
-}
-
-bool OpenFile(std::string donor_filename,
-        Treemap<int, std::string>& donor_tree) {
-    std::ifstream donor_file;
-    std::string row;
-    donor_file.open(donor_filename);
-    // If file not found, throw error and return false
-    if (donor_file.fail()) {
-        std::cerr << "Error: cannot open file wrong_don_file.dat" << std::endl;
-        return false;
-    }
-    while (std::getline(donor_file, row)) {
-        // Reads file onto row
-        if (row.size() > 0) {
-            std::string donor;
-            std::string amount_str;
-            // Records position of the ',' and final character
-            int comma = row.find(',');
-            int size = row.size();
-            // Iterates through row and appends the
-            // amount and donor values to the temp strings
-            for (int i = 0; i < comma; i++)
-                donor.push_back(row[i]);
-            for (int i = comma + 1; i < size; i++)
-                amount_str.push_back(row[i]);
-            // Amount is converted to int and inserted into tree
-            int amount_int = stoi(amount_str);
-            donor_tree.Insert(amount_int, donor);
-        }
-    }
-    donor_file.close();
-    return true;
-}
-
-int main(int argc, char* argv[]) {
-    Treemap<int, std::string> donor_tree;
-    // 3 arguments means all, rich, or cheap
-    if (argc == 3) {
-        std::string donor_filename = argv[1];
-        std::string input_command = argv[2];
-
-        OpenFile(donor_filename, donor_tree);
-        if (input_command == "all") {
-            All(donor_tree);
-        } else if (input_command == "rich") {
-            Rich(donor_tree);
-        } else if (input_command == "cheap") {
-            Cheap(donor_tree);
-        // If who is entered, specify that a fourth argument is required
-        } else if (input_command == "who") {
-            std::cerr << "Command '" << input_command <<
-                "' expects another argument: [+/-]amount" << std::endl;
-            exit(1);
-        } else {
-            std::cerr << "Command '" << input_command << "' is invalid" <<
-                std::endl << "Possible commands are: all|cheap|rich|who"
-                << std::endl;
-            exit(1);
-        }
-    // 4 arguments means who
-    } else if (argc == 4) {
-        std::string donor_filename = argv[1];
-        std::string input_command = argv[2];
-        std::string input_args = argv[3];
-        // If fourth arg is an integer
-        OpenFile(donor_filename, donor_tree);
-        if (isdigit(input_args[0])) {
-            int key = stoi(input_args);
-            Who_Amount(donor_tree, key);
-        // If fourth arg begins with '+'
-        } else if (input_args[0] == '+') {
-            input_args.erase(remove(input_args.begin(),
-                input_args.end(), '+'), input_args.end());
-            int key = stoi(input_args);
-            Who_Plus_Amount(donor_tree, key);
-        // If 4th arg begins with '-'
-        } else if (input_args[0] == '-') {
-            input_args.erase(remove(input_args.begin(),
-                input_args.end(), '-'), input_args.end());
-            int key = stoi(input_args);
-            Who_Minus_Amount(donor_tree, key);
-        } else {
-            std::cerr <<
-                "Command 'who' expects another argument : [+/ -] amount"
-                << std::endl;
-            exit(1);
-        }
-    } else {
-        std::cerr
-            << "Usage: " << argv[0] <<
-            " <donations_file.dat> <command> [<args>]" << std::endl;
-        exit(1);
-    }
-}
-#endif  // ANITABORG_CC_
+#ifndef ANITABORG_CC_
+#define ANITABORG_CC_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <stack>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "change_log.h"
+#include "donation_parser.h"
+#include "flat_treemap.h"
+#include "mapped_file.h"
+#include "mapped_treemap.h"
+#include "treemultimap.h"
+
+// Amounts are kept in cents, so that they can have two decimals
+typedef int64_t Amount;
+
+// Prints an amount in cents: whole amounts without decimals ("12"),
+// others with two ("12.50")
+struct Dollars {
+    Amount cents;
+};
+std::ostream& operator<<(std::ostream& out, Dollars amount) {
+    uint64_t cents = amount.cents < 0 ? 0 - static_cast<uint64_t>(amount.cents)
+        : amount.cents;
+    if (amount.cents < 0)
+        out << '-';
+    out << cents / 100;
+    if (cents % 100)
+        out << '.' << (cents % 100 < 10 ? "0" : "") << cents % 100;
+    return out;
+}
+
+// Parses an amount argument like the amounts of the donations file
+Amount ParseAmount(const std::string& text) {
+    return DonationParser::ParseCents(text.data(), text.data() + text.size());
+}
+
+// Donors keyed by amount, also tracking the sum of amounts per subtree.
+// Donors who gave the same amount share a key, in file order
+typedef TreeMultimap<Amount, std::string, KeySumAggregate<long long>>
+    DonorTree;
+
+// Prints every donor who donated the amount of a run
+void PrintDonors(const DonorTree::Run& donors, std::ostream& out = std::cout) {
+    for (auto& name : donors.second)
+        out << name << " (" << Dollars{donors.first} << ")" << '\n';
+}
+// all: prints all the donors by increasing order of donations
+void All(DonorTree& donor_tree) {
+    // In-order walk of the tree visits donors by increasing key
+    for (auto& donors : donor_tree)
+        PrintDonors(donors);
+}
+// rich : prints the donors who donated the largest amount
+void Rich(DonorTree& donor_tree) {
+    auto *richest = donor_tree.MaxEntry();
+    if (richest)
+        PrintDonors(*richest);
+}
+// cheap : prints the donors who donated the smallest amount
+void Cheap(DonorTree& donor_tree) {
+    auto *cheapest = donor_tree.MinEntry();
+    if (cheapest)
+        PrintDonors(*cheapest);
+}
+// Prints the donors of a run, or that there are none
+void PrintDonor(const DonorTree::Run *donors, std::ostream& out = std::cout) {
+    if (donors)
+        PrintDonors(*donors, out);
+    else
+        out << "No match" << '\n';
+}
+// who amount : prints the donors who donated amount, if any
+void Who_Amount(DonorTree& donor_tree, Amount key) {
+    PrintDonor(donor_tree.Find(key));
+}
+// who + amount : prints the donors of the next amount above amount, if any
+void Who_Plus_Amount(DonorTree& donor_tree, Amount key) {
+    PrintDonor(donor_tree.HigherEntry(key));
+}
+// who - amount : prints the donors of the next amount below amount, if any
+void Who_Minus_Amount(DonorTree& donor_tree, Amount key) {
+    PrintDonor(donor_tree.LowerEntry(key));
+}
+
+// percentile p : prints the donor at the p-th percentile of donations
+// (nearest rank), if any
+void Percentile(DonorTree& donor_tree, double p) {
+    size_t size = donor_tree.Size();
+    if (size == 0 || p < 0 || p > 100) {
+        std::cout << "No match" << '\n';
+        return;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(p / 100 * size));
+    size_t index = rank ? rank - 1 : 0;
+    // Donations are ranked individually, ties in file order
+    Amount amount = donor_tree.Select(index);
+    auto range = donor_tree.EqualRange(amount);
+    std::cout << range.first[index - donor_tree.Rank(amount)]
+        << " (" << Dollars{amount} << ")" << '\n';
+}
+// rank amount : prints how many donations are less than amount
+void Rank(DonorTree& donor_tree, Amount key) {
+    std::cout << donor_tree.Rank(key) << '\n';
+}
+
+// donor name : prints every donation made by donor name, if any. Only
+// the amounts the name is indexed under are searched when the tree
+// indexes its values (see IndexesDonors)
+void Donor(DonorTree& donor_tree, const std::string& name) {
+    std::vector<Amount> amounts = donor_tree.KeysForValue(name);
+    if (amounts.empty())
+        std::cout << "No match" << '\n';
+    for (Amount amount : amounts)
+        std::cout << name << " (" << Dollars{amount} << ")" << '\n';
+}
+// total lo hi : prints the sum of all donations between lo and hi
+void Total(DonorTree& donor_tree, Amount lo, Amount hi) {
+    std::cout << Dollars{donor_tree.RangeAggregate(lo, hi)} << '\n';
+}
+
+typedef std::pair<Amount, std::string> Donation;
+
+// Returns every donation of the tree, sorted by amount
+std::vector<Donation> Donations(DonorTree& donor_tree) {
+    std::vector<Donation> donations;
+    donations.reserve(donor_tree.Size());
+    for (auto& donors : donor_tree) {
+        for (auto& name : donors.second)
+            donations.push_back(Donation(donors.first, name));
+    }
+    return donations;
+}
+
+// save file : writes the donations to a snapshot file, which can be
+// given instead of the donations file to answer queries without loading
+void Save(DonorTree& donor_tree, const std::string& path) {
+    std::vector<Donation> donations = Donations(donor_tree);
+    SaveSnapshot(path, donations.begin(), donations.end());
+}
+
+// Donations kept as a snapshot plus a log of the changes made since
+// (--log), so that a change only appends a record to the log
+typedef ChangeLogStore<Amount, std::string> DonationStore;
+
+// The log is compacted in the background once it holds this many
+// changes, and at least one per donation
+const size_t kMinCompactChanges = 1 << 16;
+
+// Flushes a change just made to the log of @store, compacting it when it
+// has grown large
+void LogChanged(DonorTree& donor_tree, DonationStore& store) {
+    store.Flush();
+    if (store.LogSize() >= std::max(kMinCompactChanges, donor_tree.Size()))
+        store.Compact(Donations(donor_tree));
+}
+
+// give amount name : adds a donation of amount by donor name, logged to
+// @store if any
+void Give(DonorTree& donor_tree, DonationStore *store, Amount amount,
+        const std::string& name) {
+    donor_tree.Insert(amount, name);
+    if (store) {
+        store->Insert(amount, name);
+        LogChanged(donor_tree, *store);
+    }
+}
+
+// take amount name : removes a donation of amount by donor name, if any,
+// logged to @store if any
+void Take(DonorTree& donor_tree, DonationStore *store, Amount amount,
+        const std::string& name) {
+    auto names = donor_tree.EqualRange(amount);
+    if (std::find(names.first, names.second, name) == names.second) {
+        std::cout << "No match" << '\n';
+        return;
+    }
+    donor_tree.Remove(amount, name);
+    if (store) {
+        store->Remove(amount, name);
+        LogChanged(donor_tree, *store);
+    }
+}
+
+// compact : snapshots the donations of @store, starting a new log
+void Compact(DonorTree& donor_tree, DonationStore *store) {
+    if (!store)
+        throw std::invalid_argument("no store given with --log");
+    store->Compact(Donations(donor_tree));
+    store->Wait();
+}
+
+// * Queries on sorted donations
+// Same commands as above, answered by position from the donations sorted
+// by amount, either of a mapped snapshot file or of a flat map
+typedef MappedTreemap<Amount, std::string> MappedDonors;
+typedef FlatTreemap<Amount, std::string> FlatDonors;
+
+// Prints the donations at positions [first, last), or that there are none
+template <typename Sorted>
+void PrintDonors(Sorted& donors, size_t first, size_t last) {
+    if (first == last)
+        std::cout << "No match" << '\n';
+    for (size_t i = first; i < last; i++)
+        std::cout << donors.Value(i) << " (" << Dollars{donors.Key(i)}
+            << ")" << '\n';
+}
+template <typename Sorted>
+void All(Sorted& donors) {
+    for (size_t i = 0; i < donors.Size(); i++)
+        std::cout << donors.Value(i) << " (" << Dollars{donors.Key(i)}
+            << ")" << '\n';
+}
+template <typename Sorted>
+void Rich(Sorted& donors) {
+    if (!donors.Empty())
+        PrintDonors(donors, donors.LowerBound(donors.MaxKey()),
+            donors.Size());
+}
+template <typename Sorted>
+void Cheap(Sorted& donors) {
+    if (!donors.Empty())
+        PrintDonors(donors, 0, donors.UpperBound(donors.MinKey()));
+}
+template <typename Sorted>
+void Who_Amount(Sorted& donors, Amount key) {
+    PrintDonors(donors, donors.LowerBound(key), donors.UpperBound(key));
+}
+template <typename Sorted>
+void Who_Plus_Amount(Sorted& donors, Amount key) {
+    size_t first = donors.UpperBound(key);
+    size_t last = first;
+    if (first < donors.Size())
+        last = donors.UpperBound(donors.Key(first));
+    PrintDonors(donors, first, last);
+}
+template <typename Sorted>
+void Who_Minus_Amount(Sorted& donors, Amount key) {
+    size_t last = donors.LowerBound(key);
+    size_t first = last;
+    if (last > 0)
+        first = donors.LowerBound(donors.Key(last - 1));
+    PrintDonors(donors, first, last);
+}
+template <typename Sorted>
+void Percentile(Sorted& donors, double p) {
+    size_t size = donors.Size();
+    if (size == 0 || p < 0 || p > 100) {
+        std::cout << "No match" << '\n';
+        return;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(p / 100 * size));
+    size_t index = rank ? rank - 1 : 0;
+    PrintDonors(donors, index, index + 1);
+}
+template <typename Sorted>
+void Rank(Sorted& donors, Amount key) {
+    std::cout << donors.LowerBound(key) << '\n';
+}
+template <typename Sorted>
+void Donor(Sorted& donors, const std::string& name) {
+    bool found = false;
+    for (size_t i = 0; i < donors.Size(); i++) {
+        if (donors.Value(i) == name) {
+            std::cout << name << " (" << Dollars{donors.Key(i)} << ")"
+                << '\n';
+            found = true;
+        }
+    }
+    if (!found)
+        std::cout << "No match" << '\n';
+}
+template <typename Sorted>
+void Total(Sorted& donors, Amount lo, Amount hi) {
+    long long total = 0;
+    for (size_t i = donors.LowerBound(lo); i < donors.UpperBound(hi); i++)
+        total += donors.Key(i);
+    std::cout << Dollars{total} << '\n';
+}
+template <typename Sorted>
+void Save(Sorted& donors, const std::string& path) {
+    std::vector<Donation> donations;
+    for (size_t i = 0; i < donors.Size(); i++)
+        donations.push_back(Donation(donors.Key(i), donors.Value(i)));
+    SaveSnapshot(path, donations.begin(), donations.end());
+}
+// Sorted donations are read-only
+template <typename Sorted>
+void Give(Sorted&, DonationStore*, Amount, const std::string&) {
+    throw std::invalid_argument("donations are read-only");
+}
+template <typename Sorted>
+void Take(Sorted&, DonationStore*, Amount, const std::string&) {
+    throw std::invalid_argument("donations are read-only");
+}
+template <typename Sorted>
+void Compact(Sorted&, DonationStore*) {
+    throw std::invalid_argument("donations are read-only");
+}
+
+// Orders donations, or parsed rows, by amount only
+bool DonationLess(const Donation& a, const Donation& b) {
+    return a.first < b.first;
+}
+bool RowLess(const DonationRow& a, const DonationRow& b) {
+    return a.amount < b.amount;
+}
+
+// Calls @task(0) to @task(@num_tasks - 1) on one thread each and waits
+// for all of them. The first exception thrown by a task is rethrown
+template <typename F>
+void RunParallel(size_t num_tasks, F task) {
+    // A single task runs on the calling thread
+    if (num_tasks == 1) {
+        task(0);
+        return;
+    }
+    std::vector<std::exception_ptr> errors(num_tasks);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < num_tasks; i++) {
+        workers.push_back(std::thread([&task, &errors, i]() {
+            try {
+                task(i);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }));
+    }
+    for (auto& worker : workers)
+        worker.join();
+    for (auto& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+// Merges the sorted runs [bounds[i], bounds[i + 1]) of @donations into
+// one with @less. Each round merges pairs of neighbouring runs in
+// parallel, halving the number of runs; equal amounts keep their order
+template <typename T, typename Less>
+void MergeRuns(std::vector<T>& donations, const std::vector<size_t>& bounds,
+        Less less) {
+    for (size_t width = 1; width + 1 < bounds.size(); width *= 2) {
+        // Pairs start at every other run
+        std::vector<size_t> firsts;
+        for (size_t i = 0; i + width + 1 < bounds.size(); i += 2 * width)
+            firsts.push_back(i);
+        RunParallel(firsts.size(), [&](size_t pair) {
+            size_t i = firsts[pair];
+            size_t hi = bounds[std::min(i + 2 * width, bounds.size() - 1)];
+            std::inplace_merge(donations.begin() + bounds[i],
+                donations.begin() + bounds[i + width],
+                donations.begin() + hi, less);
+        });
+    }
+}
+
+// Files are parsed in chunks of at least this many bytes
+const size_t kMinChunkBytes = 1 << 20;
+
+// Loads the donations file into @donors, a DonorTree or a FlatDonors
+template <typename Donors>
+bool OpenFile(std::string donor_filename, Donors& donors) {
+    // The file is mapped and parsed in place (see DonationParser)
+    std::unique_ptr<MappedFile> donor_file;
+    try {
+        donor_file.reset(new MappedFile(donor_filename, true));
+    } catch (std::exception&) {
+        // If file not found, throw error and return false
+        std::cerr << "Error: cannot open file wrong_don_file.dat" << std::endl;
+        return false;
+    }
+    // Loading is a pipeline over chunks of whole lines, one per hardware
+    // thread: each chunk is parsed and sorted by amount on its own
+    // thread, the sorted chunks are merged, and the tree is bulk-loaded
+    // in one pass, grouping equal amounts
+    size_t num_chunks = std::min<size_t>(
+        std::max(1u, std::thread::hardware_concurrency()),
+        donor_file->Size() / kMinChunkBytes + 1);
+    std::vector<const char*> cuts = DonationParser::SplitLines(
+        donor_file->Data(), donor_file->Data() + donor_file->Size(),
+        num_chunks);
+    std::vector<DonationParser> parsers(num_chunks);
+    RunParallel(num_chunks, [&](size_t i) {
+        parsers[i].Parse(cuts[i], cuts[i + 1]);
+        // Rows are sorted while they are still small records; snapshots
+        // that are already sorted skip the sort entirely
+        std::vector<DonationRow>& rows = parsers[i].Rows();
+        if (!std::is_sorted(rows.begin(), rows.end(), RowLess))
+            std::stable_sort(rows.begin(), rows.end(), RowLess);
+    });
+    // Chunk i fills [bounds[i], bounds[i + 1]) of the donations
+    std::vector<size_t> bounds(1, 0);
+    for (auto& parser : parsers)
+        bounds.push_back(bounds.back() + parser.Rows().size());
+    std::vector<Donation> donations(bounds.back());
+    RunParallel(num_chunks, [&](size_t i) {
+        size_t at = bounds[i];
+        for (const DonationRow& row : parsers[i].Rows()) {
+            donations[at].first = row.amount;
+            donations[at++].second = parsers[i].Name(row);
+        }
+    });
+    parsers.clear();
+    MergeRuns(donations, bounds, DonationLess);
+    donors.BuildFromSorted(donations);
+    return true;
+}
+
+// Loads the donations of @store into @donor_tree: its latest snapshot,
+// then the changes logged since. A new store starts from the donations
+// file instead, which is snapshotted at once
+bool OpenStore(const std::string& donor_filename, DonorTree& donor_tree,
+        DonationStore& store) {
+    donor_tree.BuildFromSorted(store.Snapshot());
+    size_t num_changes = store.Replay([&](Change change, Amount amount,
+            const std::string& name) {
+        if (change == Change::kInsert)
+            donor_tree.Insert(amount, name);
+        else
+            donor_tree.Remove(amount, name);
+    });
+    if (store.Generation() == 0 && num_changes == 0) {
+        if (!OpenFile(donor_filename, donor_tree))
+            return false;
+        store.Compact(Donations(donor_tree));
+    }
+    return true;
+}
+
+// A 'who' command of a batch, answered ahead of the others
+struct WhoQuery {
+    char sign;  // '+', '-' or 0 for an exact amount
+    Amount amount;
+    size_t line;  // Position of the command in the batch
+};
+
+// Answers the who @queries into @answers (indexed by line) with a single
+// in-order walk over the donors, merged with the queries sorted by
+// amount. Returns false without answering when the batch is too small for
+// that to beat one lookup per query.
+bool Who_Batch(DonorTree& donor_tree, std::vector<WhoQuery>& queries,
+        std::vector<std::string>& answers) {
+    // A walk visits every key once, the lookups about log2(keys) each
+    if (queries.size() * 16 < donor_tree.KeyCount())
+        return false;
+    std::sort(queries.begin(), queries.end(),
+        [](const WhoQuery& a, const WhoQuery& b) {
+            return a.amount < b.amount;
+        });
+    // it is the first run not below the amount, prev the one before it
+    DonorTree::Iterator it = donor_tree.begin();
+    const DonorTree::Run *prev = nullptr;
+    for (const WhoQuery& query : queries) {
+        while (it != donor_tree.end() && it->first < query.amount) {
+            prev = &*it;
+            ++it;
+        }
+        const DonorTree::Run *match = nullptr;
+        if (query.sign == '-') {
+            match = prev;
+        } else if (it != donor_tree.end()) {
+            if (query.sign == 0) {
+                match = it->first == query.amount ? &*it : nullptr;
+            } else if (query.amount < it->first) {
+                match = &*it;
+            } else {
+                DonorTree::Iterator next = it;
+                ++next;
+                match = next != donor_tree.end() ? &*next : nullptr;
+            }
+        }
+        std::ostringstream out;
+        PrintDonor(match, out);
+        answers[query.line] = out.str();
+    }
+    return true;
+}
+// Sorted donations answer who commands with a binary search each
+template <typename Sorted>
+bool Who_Batch(Sorted&, std::vector<WhoQuery>&,
+        std::vector<std::string>&) {
+    return false;
+}
+
+template <typename Donors>
+bool Execute(Donors& donors, DonationStore *store,
+    const std::vector<std::string>& words);
+
+// batch [file] : runs the commands of file (or of the standard input),
+// one per line, with the donations loaded once
+template <typename Donors>
+void Batch(Donors& donors, DonationStore *store, std::istream& commands) {
+    std::vector<std::vector<std::string>> batch;
+    std::vector<WhoQuery> queries;
+    bool changes = false;
+    std::string line;
+    while (std::getline(commands, line)) {
+        std::istringstream words_in(line);
+        std::vector<std::string> words;
+        std::string word;
+        while (words_in >> word)
+            words.push_back(word);
+        if (words.empty())
+            continue;
+        // Donor names may contain spaces
+        if (words[0] == "donor" && words.size() > 2) {
+            size_t name = line.find_first_not_of(" \t",
+                line.find("donor") + 5);
+            words.resize(2);
+            words[1] = line.substr(name, line.find_last_not_of(" \t") + 1 -
+                name);
+        }
+        // So may the names of donations given or taken, which also change
+        // the answers of the commands that follow
+        if (words[0] == "give" || words[0] == "take") {
+            changes = true;
+            if (words.size() > 3) {
+                std::istringstream fields(line);
+                fields >> words[0] >> words[1] >> std::ws;
+                std::getline(fields, words[2]);
+                words[2].erase(words[2].find_last_not_of(" \t") + 1);
+                words.resize(3);
+            }
+        }
+        // who commands can be answered together, out of order
+        if (words.size() == 2 && words[0] == "who" &&
+                (isdigit(words[1][0]) || ((words[1][0] == '+' ||
+                words[1][0] == '-') && isdigit(words[1][1])))) {
+            WhoQuery query;
+            query.sign = isdigit(words[1][0]) ? 0 : words[1][0];
+            query.line = batch.size();
+            try {
+                query.amount = std::abs(ParseAmount(words[1]));
+                queries.push_back(query);
+            } catch (std::exception&) {
+                // Left to Execute to report
+            }
+        }
+        batch.push_back(words);
+    }
+
+    std::vector<std::string> answers(batch.size());
+    std::vector<bool> answered(batch.size(), false);
+    if (!changes && !queries.empty() &&
+            Who_Batch(donors, queries, answers)) {
+        for (const WhoQuery& query : queries)
+            answered[query.line] = true;
+    }
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (answered[i]) {
+            std::cout << answers[i];
+            continue;
+        }
+        // A bad command is reported and skipped
+        try {
+            Execute(donors, store, batch[i]);
+        } catch (std::exception& error) {
+            std::cerr << "Command '" << batch[i][0] << "' failed: "
+                << error.what() << std::endl;
+        }
+    }
+}
+
+// Runs one command (its name and arguments) on @donors, or reports why it
+// is invalid and returns false. Changes are logged to @store, if any
+template <typename Donors>
+bool Execute(Donors& donors, DonationStore *store,
+        const std::vector<std::string>& words) {
+    std::string input_command = words[0];
+    // Commands without arguments are all, rich, cheap, batch or compact
+    if (words.size() == 1) {
+        if (input_command == "all") {
+            All(donors);
+        } else if (input_command == "rich") {
+            Rich(donors);
+        } else if (input_command == "cheap") {
+            Cheap(donors);
+        } else if (input_command == "batch") {
+            Batch(donors, store, std::cin);
+        } else if (input_command == "compact") {
+            Compact(donors, store);
+        // If who, percentile or rank is entered, specify that a fourth
+        // argument is required
+        } else if (input_command == "who") {
+            std::cerr << "Command '" << input_command <<
+                "' expects another argument: [+/-]amount" << std::endl;
+            return false;
+        } else if (input_command == "percentile") {
+            std::cerr << "Command '" << input_command <<
+                "' expects another argument: percentile" << std::endl;
+            return false;
+        } else if (input_command == "rank") {
+            std::cerr << "Command '" << input_command <<
+                "' expects another argument: amount" << std::endl;
+            return false;
+        } else if (input_command == "donor") {
+            std::cerr << "Command '" << input_command <<
+                "' expects another argument: name" << std::endl;
+            return false;
+        } else if (input_command == "total") {
+            std::cerr << "Command '" << input_command <<
+                "' expects two more arguments: low high" << std::endl;
+            return false;
+        } else if (input_command == "save") {
+            std::cerr << "Command '" << input_command <<
+                "' expects another argument: snapshot file" << std::endl;
+            return false;
+        } else if (input_command == "give" || input_command == "take") {
+            std::cerr << "Command '" << input_command <<
+                "' expects two more arguments: amount name" << std::endl;
+            return false;
+        } else {
+            std::cerr << "Command '" << input_command << "' is invalid" <<
+                std::endl << "Possible commands are: "
+                "all|cheap|rich|who|percentile|rank|donor|total|save|batch|"
+                "give|take|compact" << std::endl;
+            return false;
+        }
+    // One argument means who, percentile, rank, donor, save or batch
+    } else if (words.size() == 2) {
+        std::string input_args = words[1];
+        if (input_command == "save") {
+            Save(donors, input_args);
+        } else if (input_command == "batch") {
+            std::ifstream commands(input_args);
+            if (commands.fail()) {
+                std::cerr << "Error: cannot open file " << input_args
+                    << std::endl;
+                return false;
+            }
+            Batch(donors, store, commands);
+        } else if (input_command == "percentile") {
+            Percentile(donors, stod(input_args));
+        } else if (input_command == "rank") {
+            Rank(donors, ParseAmount(input_args));
+        } else if (input_command == "donor") {
+            Donor(donors, input_args);
+        } else if (input_command == "give" || input_command == "take") {
+            std::cerr << "Command '" << input_command <<
+                "' expects another argument: name" << std::endl;
+            return false;
+        // If fourth arg is an integer
+        } else if (isdigit(input_args[0])) {
+            Amount key = ParseAmount(input_args);
+            Who_Amount(donors, key);
+        // If fourth arg begins with '+'
+        } else if (input_args[0] == '+') {
+            input_args.erase(remove(input_args.begin(),
+                input_args.end(), '+'), input_args.end());
+            Amount key = ParseAmount(input_args);
+            Who_Plus_Amount(donors, key);
+        // If 4th arg begins with '-'
+        } else if (input_args[0] == '-') {
+            input_args.erase(remove(input_args.begin(),
+                input_args.end(), '-'), input_args.end());
+            Amount key = ParseAmount(input_args);
+            Who_Minus_Amount(donors, key);
+        } else {
+            std::cerr <<
+                "Command 'who' expects another argument : [+/ -] amount"
+                << std::endl;
+            return false;
+        }
+    // Two arguments means total
+    } else if (words.size() == 3 && input_command == "total") {
+        Total(donors, ParseAmount(words[1]), ParseAmount(words[2]));
+    } else if (words.size() == 3 && input_command == "give") {
+        Give(donors, store, ParseAmount(words[1]), words[2]);
+    } else if (words.size() == 3 && input_command == "take") {
+        Take(donors, store, ParseAmount(words[1]), words[2]);
+    } else {
+        std::cerr << "Command '" << input_command <<
+            "' has too many arguments" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Whether @command looks up donors by name, so that the tree it runs on
+// should index them: the index is built along with the tree, in a single
+// pass, and only pays off for these commands
+bool IndexesDonors(const std::string& command) {
+    return command == "donor" || command == "batch";
+}
+
+int main(int argc, char* argv[]) {
+    // --flat loads the donations into a FlatDonors instead of a tree,
+    // which is faster to query when nothing is removed
+    std::string program = argv[0];
+    bool flat = argc > 1 && std::string(argv[1]) == "--flat";
+    if (flat) {
+        argv++;
+        argc--;
+    }
+    // --log keeps the donations in a store (see OpenStore), where give
+    // and take log their changes, so they last from one run to the next
+    std::string store_path;
+    if (!flat && argc > 2 && std::string(argv[1]) == "--log") {
+        store_path = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+    std::string command = argc > 2 ? argv[2] : "";
+    if (argc != 3 && argc != 4 && !(argc == 5 && (command == "total" ||
+            command == "give" || command == "take"))) {
+        std::cerr
+            << "Usage: " << program << " [--flat | --log <store>]"
+            " <donations_file.dat> <command> [<args>]" << std::endl;
+        exit(1);
+    }
+    // Output is flushed once at exit (or when the buffer fills), which
+    // matters when a batch prints many lines
+    std::ios::sync_with_stdio(false);
+    std::vector<std::string> words(argv + 2, argv + argc);
+    bool ok;
+    try {
+        if (!store_path.empty()) {
+            DonationStore store(store_path);
+            DonorTree donor_tree;
+            donor_tree.IndexValues(IndexesDonors(command));
+            ok = OpenStore(argv[1], donor_tree, store) &&
+                Execute(donor_tree, &store, words);
+            store.Wait();
+        // Snapshots written by 'save' are queried in place, without loading
+        } else if (IsSnapshot(argv[1])) {
+            MappedDonors donors(argv[1]);
+            ok = Execute(donors, nullptr, words);
+        } else if (flat) {
+            FlatDonors donors;
+            ok = OpenFile(argv[1], donors) && Execute(donors, nullptr, words);
+        } else {
+            DonorTree donor_tree;
+            donor_tree.IndexValues(IndexesDonors(command));
+            ok = OpenFile(argv[1], donor_tree) &&
+                Execute(donor_tree, nullptr, words);
+        }
+    } catch (std::exception& error) {
+        std::cerr << "Command '" << words[0] << "' failed: " << error.what()
+            << std::endl;
+        ok = false;
+    }
+    if (!ok)
+        exit(1);
+}
+#endif  // ANITABORG_CC_
@@ -0,0 +1,94 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent_treemap.h"
+#include "treemap.h"
+
+// Usage: bench_concurrent [num_keys] [millis]
+// Runs 1 to 8 reader threads doing Get on random keys while one writer
+// keeps removing and re-inserting keys, and reports the total reader and
+// writer throughput, for ConcurrentTreemap and for a Treemap behind a
+// mutex.
+
+typedef std::chrono::steady_clock Clock;
+
+// Treemap with every operation under one lock
+class LockedTreemap {
+ public:
+  void Insert(int key, int value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    map.Insert(key, value);
+  }
+  void Remove(int key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    map.Remove(key);
+  }
+  bool ContainsKey(int key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return map.ContainsKey(key);
+  }
+
+ private:
+  std::mutex mutex;
+  Treemap<int, int> map;
+};
+
+template <typename Map>
+static void Bench(const std::string& name, size_t num_readers,
+    int num_keys, int millis) {
+  Map map;
+  for (int key = 0; key < num_keys; key++)
+    map.Insert(key, key);
+
+  std::atomic<bool> done(false);
+  std::atomic<size_t> reads(0);
+  size_t writes = 0;
+  std::vector<std::thread> readers;
+  for (size_t r = 0; r < num_readers; r++) {
+    readers.push_back(std::thread([&, r]() {
+      std::mt19937 random(r);
+      size_t count = 0;
+      size_t found = 0;
+      while (!done.load(std::memory_order_relaxed)) {
+        found += map.ContainsKey(random() % num_keys);
+        count++;
+      }
+      reads += count + (found == 42);
+    }));
+  }
+  // The writer churns a tenth of the keys until the time is up
+  Clock::time_point end = Clock::now() + std::chrono::milliseconds(millis);
+  std::mt19937 random(1000);
+  while (Clock::now() < end) {
+    int key = random() % (num_keys / 10 + 1);
+    map.Remove(key);
+    map.Insert(key, key);
+    writes += 2;
+  }
+  done = true;
+  for (auto& reader : readers)
+    reader.join();
+
+  double seconds = millis / 1000.0;
+  std::cout << name << "\treaders " << num_readers << "\treads "
+      << reads / seconds / 1e6 << " M/s\twrites "
+      << writes / seconds / 1e6 << " M/s" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  int num_keys = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  int millis = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+  for (size_t readers = 1; readers <= 8; readers *= 2) {
+    Bench<ConcurrentTreemap<int, int>>("ConcurrentTreemap", readers,
+        num_keys, millis);
+    Bench<LockedTreemap>("Treemap+mutex", readers, num_keys, millis);
+  }
+}
@@ -0,0 +1,89 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "donation_parser.h"
+#include "mapped_file.h"
+
+// Usage: bench_parser [donations_file]
+// Times reading a donations file with the original getline/stoi loop and
+// with MappedFile + DonationParser, reporting rows/s and MB/s. Without a
+// file, one million synthetic rows are generated first.
+
+typedef std::chrono::steady_clock Clock;
+
+static const char kSyntheticPath[] = "bench_parser.dat";
+
+// Writes @rows random "name,amount" lines to @path
+static void WriteSynthetic(const std::string& path, size_t rows) {
+  std::mt19937 random(42);
+  std::ofstream file(path);
+  for (size_t i = 0; i < rows; i++) {
+    file << "Donor " << random() % 100000 << " " << i << ","
+        << random() % 1000000 << "\n";
+  }
+}
+
+// The loop anitaborg_donations used: a std::string per line, per name
+// and per amount
+static size_t ParseGetline(const std::string& path) {
+  std::ifstream file(path);
+  std::vector<std::pair<int, std::string>> donations;
+  std::string row;
+  while (std::getline(file, row)) {
+    if (row.size() > 0) {
+      std::string donor;
+      std::string amount_str;
+      int comma = row.find(',');
+      int size = row.size();
+      for (int i = 0; i < comma; i++)
+        donor.push_back(row[i]);
+      for (int i = comma + 1; i < size; i++)
+        amount_str.push_back(row[i]);
+      donations.push_back(std::make_pair(stoi(amount_str), donor));
+    }
+  }
+  return donations.size();
+}
+
+static size_t ParseMapped(const std::string& path) {
+  MappedFile file(path, true);
+  DonationParser parser;
+  parser.Parse(file.Data(), file.Data() + file.Size());
+  return parser.Rows().size();
+}
+
+// Runs @parse on @path a few times and reports the best run
+template <typename F>
+static void Bench(const std::string& name, const std::string& path,
+    size_t bytes, F parse) {
+  double best = 0;
+  size_t rows = 0;
+  for (int run = 0; run < 5; run++) {
+    Clock::time_point start = Clock::now();
+    rows = parse(path);
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    if (run == 0 || elapsed.count() < best)
+      best = elapsed.count();
+  }
+  std::cout << name << "\trows " << rows << "\trows/s " << rows / best
+      << "\tMB/s " << bytes / best / 1e6 << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  std::string path = argc > 1 ? argv[1] : kSyntheticPath;
+  if (argc <= 1)
+    WriteSynthetic(path, 1000000);
+  size_t bytes = MappedFile(path).Size();
+
+  Bench("getline", path, bytes, ParseGetline);
+  Bench("mapped", path, bytes, ParseMapped);
+  if (argc <= 1)
+    std::remove(kSyntheticPath);
+  return 0;
+}
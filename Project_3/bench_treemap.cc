@@ -0,0 +1,334 @@
+#include <malloc.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "btreemap.h"
+#include "flat_treemap.h"
+#include "treemap.h"
+
+// Usage: bench_treemap [num_keys]
+// Runs every map on four workloads, which differ in the order keys are
+// inserted and looked up:
+//   sorted, reverse  keys inserted in increasing/decreasing order
+//   random           keys inserted in random order
+//   zipfian          keys inserted in random order, and looked up with a
+//                    Zipfian distribution (s = 1) over a random ranking,
+//                    so that a few hot keys get most lookups
+// For each it reports nanoseconds per Insert, Remove (in insertion order,
+// or by decreasing popularity for zipfian), Get, FloorKey and CeilKey
+// (between keys), and ContainsValue, along with the tree height and the
+// heap bytes per entry. Treemap/keys and Treemap/values are Treemaps with
+// their key and value index, and FlatTreemap, which is read-only, is
+// built in one go from the sorted entries. Then times a remove/insert
+// churn, counting calls to the global allocator.
+
+typedef std::chrono::steady_clock Clock;
+
+// Calls to the global operator new, where every node of a map without a
+// pool comes from, and the bytes they hold
+static size_t num_allocs = 0;
+static size_t live_bytes = 0;
+
+void *operator new(size_t size) {
+  num_allocs++;
+  void *p = std::malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  live_bytes += malloc_usable_size(p);
+  return p;
+}
+
+// Kept out of line, or the compiler sees free() called on memory from
+// operator new (which it can't tell is malloc'ed here)
+__attribute__((noinline)) static void Release(void *p) noexcept {
+  if (p)
+    live_bytes -= malloc_usable_size(p);
+  std::free(p);
+}
+
+void operator delete(void *p) noexcept {
+  Release(p);
+}
+
+// Sized deallocation (C++14) would otherwise reach the library's delete
+void operator delete(void *p, size_t) noexcept {
+  Release(p);
+}
+
+static double NsPerOp(Clock::time_point start, size_t ops) {
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  return elapsed.count() / ops;
+}
+
+// Operations of a workload, in the order they are run
+struct Workload {
+  std::string name;
+  std::vector<int> inserts;
+  std::vector<int> probes;
+  std::vector<int> removes;
+};
+
+// Measurements of one map on one workload; negative if not supported
+struct Result {
+  double insert_ns = -1;
+  double remove_ns = -1;
+  double get_ns = -1;
+  double floor_ns = -1;
+  double ceil_ns = -1;
+  double value_ns = -1;
+  size_t height = 0;
+  double bytes = 0;
+};
+
+static void PrintHeader() {
+  std::cout << std::left << std::setw(9) << "workload" << std::setw(16)
+      << "map" << std::right;
+  for (const char *column : {"insert", "remove", "get", "floor", "ceil",
+      "value", "height", "B/entry"})
+    std::cout << std::setw(10) << column;
+  std::cout << "\n" << std::fixed << std::setprecision(0);
+}
+
+static void PrintColumn(double value) {
+  if (value < 0)
+    std::cout << std::setw(10) << "-";
+  else
+    std::cout << std::setw(10) << value;
+}
+
+static void Report(const std::string& workload, const std::string& name,
+    const Result& result) {
+  std::cout << std::left << std::setw(9) << workload << std::setw(16)
+      << name << std::right;
+  PrintColumn(result.insert_ns);
+  PrintColumn(result.remove_ns);
+  PrintColumn(result.get_ns);
+  PrintColumn(result.floor_ns);
+  PrintColumn(result.ceil_ns);
+  PrintColumn(result.value_ns);
+  PrintColumn(result.height ? result.height : -1.0);
+  PrintColumn(result.bytes);
+  std::cout << std::endl;
+}
+
+// Treemap with its key index enabled
+class IndexedTreemap : public Treemap<int, int> {
+ public:
+  IndexedTreemap() {
+    IndexKeys(true);
+  }
+};
+
+// Treemap with its value index enabled
+class ValueIndexedTreemap : public Treemap<int, int> {
+ public:
+  ValueIndexedTreemap() {
+    IndexValues(true);
+  }
+};
+
+// Treemap API over std::map
+class StdMap : public std::map<int, int> {
+ public:
+  void Insert(int key, int value) {
+    emplace(key, value);
+  }
+  void Remove(int key) {
+    erase(key);
+  }
+  const int& Get(int key) {
+    return find(key)->second;
+  }
+  const int& FloorKey(int key) {
+    return std::prev(upper_bound(key))->first;
+  }
+  const int& CeilKey(int key) {
+    return lower_bound(key)->first;
+  }
+  bool ContainsValue(int value) {
+    for (auto& entry : *this) {
+      if (entry.second == value)
+        return true;
+    }
+    return false;
+  }
+  size_t Height() {
+    return 0;
+  }
+};
+
+// Number of ContainsValue calls timed, which take O(N) on most maps; each
+// looks up one of the @num_probes probes
+static size_t NumValueScans(size_t num_keys, size_t num_probes) {
+  return std::min(num_probes, std::max<size_t>(1, (1 << 24) / num_keys));
+}
+
+// Times the lookups of @workload on @map, adding to @sum
+template <typename Map>
+static void Lookups(Map& map, const Workload& workload, Result *result,
+    long *sum) {
+  // Keys are even, so that floors and ceils are searched between keys
+  const std::vector<int>& probes = workload.probes;
+  Clock::time_point start = Clock::now();
+  for (int key : probes)
+    *sum += map.Get(key);
+  result->get_ns = NsPerOp(start, probes.size());
+  start = Clock::now();
+  for (int key : probes)
+    *sum += map.FloorKey(key + 1);
+  result->floor_ns = NsPerOp(start, probes.size());
+  start = Clock::now();
+  for (int key : probes)
+    *sum += map.CeilKey(key - 1);
+  result->ceil_ns = NsPerOp(start, probes.size());
+}
+
+// Times any map with the Treemap API
+template <typename Map>
+static long Bench(const std::string& name, const Workload& workload) {
+  long sum = 0;
+  Result result;
+  size_t bytes = live_bytes;
+  std::unique_ptr<Map> map(new Map());
+  Clock::time_point start = Clock::now();
+  for (int key : workload.inserts)
+    map->Insert(key, key);
+  result.insert_ns = NsPerOp(start, workload.inserts.size());
+  result.bytes = double(live_bytes - bytes) / workload.inserts.size();
+  result.height = map->Height();
+
+  Lookups(*map, workload, &result, &sum);
+  size_t num_scans = NumValueScans(workload.inserts.size(),
+      workload.probes.size());
+  start = Clock::now();
+  for (size_t i = 0; i < num_scans; i++)
+    sum += map->ContainsValue(workload.probes[i]);
+  result.value_ns = NsPerOp(start, num_scans);
+
+  start = Clock::now();
+  for (int key : workload.removes)
+    map->Remove(key);
+  result.remove_ns = NsPerOp(start, workload.removes.size());
+  Report(workload.name, name, result);
+  return sum;
+}
+
+// Times FlatTreemap, which is built from the sorted entries
+static long BenchFlat(const Workload& workload) {
+  long sum = 0;
+  Result result;
+  std::vector<std::pair<int, int>> entries;
+  for (int key : workload.inserts)
+    entries.emplace_back(key, key);
+  std::sort(entries.begin(), entries.end());
+  size_t bytes = live_bytes;
+  std::unique_ptr<FlatTreemap<int, int>> map(new FlatTreemap<int, int>());
+  Clock::time_point start = Clock::now();
+  map->BuildFromSorted(entries);
+  result.insert_ns = NsPerOp(start, entries.size());
+  result.bytes = double(live_bytes - bytes) / entries.size();
+  // Searches take the depth of the implicit tree
+  result.height = std::floor(std::log2(entries.size())) + 1;
+  Lookups(*map, workload, &result, &sum);
+  Report(workload.name, "FlatTreemap", result);
+  return sum;
+}
+
+static void Run(const Workload& workload) {
+  long sum = 0;
+  sum += Bench<Treemap<int, int>>("Treemap", workload);
+  sum += Bench<IndexedTreemap>("Treemap/keys", workload);
+  sum += Bench<ValueIndexedTreemap>("Treemap/values", workload);
+  sum += Bench<BTreemap<int, int>>("BTreemap", workload);
+  sum += BenchFlat(workload);
+  sum += Bench<StdMap>("std::map", workload);
+  // Keeps the lookups from being optimized away
+  if (sum == 42)
+    std::cout << std::endl;
+}
+
+// Return @count ranks in [0, @n) drawn from a Zipfian distribution with
+// exponent 1: rank r is drawn with probability proportional to 1 / (r + 1)
+static std::vector<size_t> ZipfRanks(size_t n, size_t count,
+    std::mt19937& random) {
+  std::vector<double> cdf(n);
+  double total = 0;
+  for (size_t r = 0; r < n; r++)
+    cdf[r] = total += 1.0 / (r + 1);
+  std::uniform_real_distribution<double> uniform(0, total);
+  std::vector<size_t> ranks(count);
+  for (size_t& rank : ranks) {
+    rank = std::upper_bound(cdf.begin(), cdf.end(), uniform(random)) -
+        cdf.begin();
+    rank = std::min(rank, n - 1);
+  }
+  return ranks;
+}
+
+// Times removing each of @keys and inserting a new key in its place, on a
+// map holding all of @keys
+template <typename Map>
+static void Churn(const std::string& name, const std::vector<int>& keys) {
+  Map map;
+  for (int key : keys)
+    map.Insert(key, key);
+  int offset = 2 * keys.size();
+  size_t allocs = num_allocs;
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0; i < keys.size(); i++) {
+    map.Remove(keys[i]);
+    map.Insert(keys[i] + offset, i);
+  }
+  double step_ns = NsPerOp(start, keys.size());
+  std::cout << "churn\t" << name << "\tremove+insert " << step_ns
+      << " ns/op\tallocs " << double(num_allocs - allocs) / keys.size()
+      << "/op" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  size_t num_keys = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  num_keys = std::max<size_t>(num_keys, 1);
+  std::mt19937 random(42);
+
+  std::vector<int> sorted(num_keys);
+  for (size_t i = 0; i < num_keys; i++)
+    sorted[i] = 2 * i;
+  std::vector<int> shuffled(sorted);
+  std::shuffle(shuffled.begin(), shuffled.end(), random);
+  // Lookups are done in a different random order than insertion
+  std::vector<int> probes(sorted);
+  std::shuffle(probes.begin(), probes.end(), random);
+
+  PrintHeader();
+  Run({"sorted", sorted, probes, sorted});
+  std::vector<int> reverse(sorted.rbegin(), sorted.rend());
+  Run({"reverse", reverse, probes, reverse});
+  Run({"random", shuffled, probes, shuffled});
+  // Key ranked r is hot[r]
+  std::vector<int> hot(sorted);
+  std::shuffle(hot.begin(), hot.end(), random);
+  std::vector<int> zipf_probes;
+  for (size_t rank : ZipfRanks(num_keys, num_keys, random))
+    zipf_probes.push_back(hot[rank]);
+  Run({"zipfian", shuffled, zipf_probes, hot});
+  std::cout << std::defaultfloat << std::setprecision(6);
+
+  Churn<Treemap<int, int>>("Treemap", shuffled);
+  Churn<IndexedTreemap>("Treemap/keys", shuffled);
+  Churn<Treemap<int, int, NoAggregate, std::less<int>,
+      std::allocator<std::pair<const int, int>>>>("Treemap/new", shuffled);
+  Churn<StdMap>("std::map", shuffled);
+}
@@ -0,0 +1,514 @@
+#ifndef BTREEMAP_H_
+#define BTREEMAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// B+-tree with the same public API as Treemap.
+//
+// Every node holds up to kMaxKeys keys stored contiguously, so a lookup
+// touches one node (a few cache lines) per level instead of one pointer per
+// key comparison, and the tree is only log_B(N) levels deep. Keys are only
+// stored with their values in the leaves; inner nodes hold copies of keys
+// as separators. Leaves are chained in both directions so that FloorKey and
+// CeilKey can step into a neighbouring leaf without another descent.
+//
+// Keys and values must be default constructible and copy assignable.
+template <typename K, typename V>
+class BTreemap {
+ public:
+  // Constructor/Destructor
+  BTreemap() = default;
+  ~BTreemap();
+  BTreemap(const BTreemap&) = delete;
+  BTreemap& operator=(const BTreemap&) = delete;
+
+  // * Capacity
+  // Returns number of key-value mappings in map --O(1)
+  size_t Size();
+
+  // Returns true if map is empty --O(1)
+  bool Empty();
+
+  // Return number of levels in the tree, 0 if empty --O(1)
+  size_t Height();
+
+  // * Modifiers
+  // Inserts @key in map --O(log N)
+  // Throws exception if key already exists
+  void Insert(const K& key, const V& value);
+
+  // Remove @key from map --O(log N)
+  // Throws exception if key doesn't exists
+  void Remove(const K& key);
+
+  // * Lookup
+  // Return value corresponding to @key --O(log N)
+  // Throws exception if tree is empty or key doesn't exists
+  const V& Get(const K& key);
+
+  // Return greatest key less than or equal to @key --O(log N)
+  // Throws exception if tree is empty or no floor exists for key
+  const K& FloorKey(const K& key);
+
+  // Return least key greater than or equal to @key --O(log N)
+  // Throws exception if tree is empty or no ceil exists for key
+  const K& CeilKey(const K& key);
+
+  // Return whether @key is found in map --O(log N)
+  bool ContainsKey(const K& key);
+
+  // Return whether @value is found in map --O(N)
+  bool ContainsValue(const V& value);
+
+  // Return max key in map --O(1)
+  // Throws exception if tree is empty
+  const K& MaxKey();
+
+  // Return min key in map --O(1)
+  // Throws exception if tree is empty
+  const K& MinKey();
+
+ private:
+  // Private constants
+  // Keys per node: 256 bytes worth of keys (4 cache lines), at least 8
+  static const size_t kMaxKeys = 256 / sizeof(K) < 8 ? 8 : 256 / sizeof(K);
+  // Every node except the root keeps at least this many keys
+  static const size_t kMinKeys = kMaxKeys / 2;
+
+  // Private member variables
+  // Arrays have one spare slot so a node can overflow before it splits
+  struct Node {
+    explicit Node(bool is_leaf) : is_leaf(is_leaf) {}
+    bool is_leaf;
+    size_t count = 0;
+    K keys[kMaxKeys + 1];
+  };
+  // Child i holds the keys less than keys[i] and greater or equal to
+  // keys[i - 1]
+  struct Inner : Node {
+    Inner() : Node(false) {}
+    Node *children[kMaxKeys + 2];
+  };
+  struct Leaf : Node {
+    Leaf() : Node(true) {}
+    V values[kMaxKeys + 1];
+    Leaf *prev = nullptr;
+    Leaf *next = nullptr;
+  };
+  // Inner node visited on the way down, and which child was taken
+  struct Step {
+    Inner *node;
+    size_t child;
+  };
+
+  Node *root = nullptr;
+  Leaf *head = nullptr;
+  Leaf *tail = nullptr;
+  size_t cur_size = 0;
+  size_t height = 0;
+
+  // Private methods
+  // * Helper methods for searching inside a node
+  // Number of keys in @n less than @key
+  static size_t LowerBound(const Node *n, const K& key);
+  // Number of keys in @n less than or equal to @key
+  static size_t UpperBound(const Node *n, const K& key);
+
+  // Descends to the leaf that would hold @key, recording the path if
+  // @path isn't null
+  Leaf *FindLeaf(const K& key, std::vector<Step> *path);
+
+  // * Helper methods for restructuring
+  // Splits overflowing @n, returns the new right sibling and sets @sep to
+  // the separator to insert in the parent
+  Node *Split(Node *n, K *sep);
+  // Inserts separator @sep and right child @right after child @i of @n
+  static void InsertChild(Inner *n, size_t i, const K& sep, Node *right);
+  // Removes separator @i and child @i + 1 of @n
+  static void EraseChild(Inner *n, size_t i);
+  // Fixes underflowing child @i of @parent by borrowing from or merging
+  // with a sibling
+  void FixUnderflow(Inner *parent, size_t i);
+  // Moves all of @right into its left sibling @left, then frees @right
+  void Merge(Inner *parent, size_t i, Node *left, Node *right);
+};
+
+template <typename K, typename V>
+BTreemap<K, V>::~BTreemap() {
+  std::vector<Node*> stack;
+  if (root)
+    stack.push_back(root);
+  while (!stack.empty()) {
+    Node *n = stack.back();
+    stack.pop_back();
+    if (n->is_leaf) {
+      delete static_cast<Leaf*>(n);
+    } else {
+      Inner *in = static_cast<Inner*>(n);
+      for (size_t i = 0; i <= in->count; i++)
+        stack.push_back(in->children[i]);
+      delete in;
+    }
+  }
+}
+
+template <typename K, typename V>
+size_t BTreemap<K, V>::Size() {
+  return cur_size;
+}
+
+template <typename K, typename V>
+bool BTreemap<K, V>::Empty() {
+  return cur_size == 0;
+}
+
+template <typename K, typename V>
+size_t BTreemap<K, V>::Height() {
+  return height;
+}
+
+template <typename K, typename V>
+size_t BTreemap<K, V>::LowerBound(const Node *n, const K& key) {
+  // Counting instead of breaking out of the loop keeps it free of
+  // data-dependent branches, so the compiler can vectorize it for
+  // arithmetic keys; a node is only a few cache lines long anyway
+  size_t pos = 0;
+  for (size_t i = 0; i < n->count; i++)
+    pos += n->keys[i] < key;
+  return pos;
+}
+
+template <typename K, typename V>
+size_t BTreemap<K, V>::UpperBound(const Node *n, const K& key) {
+  size_t pos = 0;
+  for (size_t i = 0; i < n->count; i++)
+    pos += !(key < n->keys[i]);
+  return pos;
+}
+
+template <typename K, typename V>
+typename BTreemap<K, V>::Leaf* BTreemap<K, V>::FindLeaf(const K& key,
+    std::vector<Step> *path) {
+  Node *n = root;
+  while (!n->is_leaf) {
+    Inner *in = static_cast<Inner*>(n);
+    size_t i = UpperBound(in, key);
+    if (path)
+      path->push_back(Step{ in, i });
+    n = in->children[i];
+  }
+  return static_cast<Leaf*>(n);
+}
+
+template <typename K, typename V>
+void BTreemap<K, V>::Insert(const K& key, const V& value) {
+  if (!root) {
+    head = tail = new Leaf();
+    root = head;
+    height = 1;
+  }
+  std::vector<Step> path;
+  Leaf *leaf = FindLeaf(key, &path);
+  size_t pos = LowerBound(leaf, key);
+  if (pos < leaf->count && !(key < leaf->keys[pos]))
+    throw std::invalid_argument("Duplicate Key");
+
+  // Shift the larger entries right by one and insert in place
+  std::copy_backward(leaf->keys + pos, leaf->keys + leaf->count,
+      leaf->keys + leaf->count + 1);
+  std::copy_backward(leaf->values + pos, leaf->values + leaf->count,
+      leaf->values + leaf->count + 1);
+  leaf->keys[pos] = key;
+  leaf->values[pos] = value;
+  leaf->count++;
+  cur_size++;
+
+  // Split overflowing nodes from the leaf up, growing a new root if the
+  // split reaches the top
+  Node *n = leaf;
+  while (n->count > kMaxKeys) {
+    K sep;
+    Node *right = Split(n, &sep);
+    if (path.empty()) {
+      Inner *new_root = new Inner();
+      new_root->keys[0] = sep;
+      new_root->children[0] = n;
+      new_root->children[1] = right;
+      new_root->count = 1;
+      root = new_root;
+      height++;
+      break;
+    }
+    Step step = path.back();
+    path.pop_back();
+    InsertChild(step.node, step.child, sep, right);
+    n = step.node;
+  }
+}
+
+template <typename K, typename V>
+typename BTreemap<K, V>::Node* BTreemap<K, V>::Split(Node *n, K *sep) {
+  if (n->is_leaf) {
+    Leaf *left = static_cast<Leaf*>(n);
+    Leaf *right = new Leaf();
+    size_t mid = left->count / 2;
+    right->count = left->count - mid;
+    std::copy(left->keys + mid, left->keys + left->count, right->keys);
+    std::copy(left->values + mid, left->values + left->count,
+        right->values);
+    left->count = mid;
+    // Chain the new leaf after the old one
+    right->prev = left;
+    right->next = left->next;
+    if (left->next)
+      left->next->prev = right;
+    else
+      tail = right;
+    left->next = right;
+    *sep = right->keys[0];
+    return right;
+  }
+  // Inner nodes push their middle key up instead of copying it
+  Inner *left = static_cast<Inner*>(n);
+  Inner *right = new Inner();
+  size_t mid = left->count / 2;
+  right->count = left->count - mid - 1;
+  std::copy(left->keys + mid + 1, left->keys + left->count, right->keys);
+  std::copy(left->children + mid + 1, left->children + left->count + 1,
+      right->children);
+  *sep = left->keys[mid];
+  left->count = mid;
+  return right;
+}
+
+template <typename K, typename V>
+void BTreemap<K, V>::InsertChild(Inner *n, size_t i, const K& sep,
+    Node *right) {
+  std::copy_backward(n->keys + i, n->keys + n->count,
+      n->keys + n->count + 1);
+  std::copy_backward(n->children + i + 1, n->children + n->count + 1,
+      n->children + n->count + 2);
+  n->keys[i] = sep;
+  n->children[i + 1] = right;
+  n->count++;
+}
+
+template <typename K, typename V>
+void BTreemap<K, V>::EraseChild(Inner *n, size_t i) {
+  std::copy(n->keys + i + 1, n->keys + n->count, n->keys + i);
+  std::copy(n->children + i + 2, n->children + n->count + 1,
+      n->children + i + 1);
+  n->count--;
+}
+
+template <typename K, typename V>
+void BTreemap<K, V>::Remove(const K& key) {
+  if (!root)
+    throw std::invalid_argument("Invalid  key");
+  std::vector<Step> path;
+  Leaf *leaf = FindLeaf(key, &path);
+  size_t pos = LowerBound(leaf, key);
+  // If key not found, throw error
+  if (pos == leaf->count || key < leaf->keys[pos])
+    throw std::invalid_argument("Invalid  key");
+
+  std::copy(leaf->keys + pos + 1, leaf->keys + leaf->count,
+      leaf->keys + pos);
+  std::copy(leaf->values + pos + 1, leaf->values + leaf->count,
+      leaf->values + pos);
+  leaf->count--;
+  cur_size--;
+
+  // Separators equal to the removed key are left in place: they still
+  // route every remaining key correctly. Underflowing nodes are fixed from
+  // the leaf up for as long as the fix leaves the parent underflowing.
+  Node *n = leaf;
+  while (!path.empty() && n->count < kMinKeys) {
+    Step step = path.back();
+    path.pop_back();
+    FixUnderflow(step.node, step.child);
+    n = step.node;
+  }
+
+  // Shrink the tree when the root runs out of keys
+  if (root->count == 0) {
+    if (root->is_leaf) {
+      delete static_cast<Leaf*>(root);
+      root = head = tail = nullptr;
+      height = 0;
+    } else {
+      Inner *old_root = static_cast<Inner*>(root);
+      root = old_root->children[0];
+      delete old_root;
+      height--;
+    }
+  }
+}
+
+template <typename K, typename V>
+void BTreemap<K, V>::FixUnderflow(Inner *parent, size_t i) {
+  Node *n = parent->children[i];
+  Node *left = i > 0 ? parent->children[i - 1] : nullptr;
+  Node *right = i < parent->count ? parent->children[i + 1] : nullptr;
+
+  if (left && left->count > kMinKeys) {
+    // Borrow the last entry of the left sibling
+    std::copy_backward(n->keys, n->keys + n->count,
+        n->keys + n->count + 1);
+    if (n->is_leaf) {
+      Leaf *l = static_cast<Leaf*>(left);
+      Leaf *leaf = static_cast<Leaf*>(n);
+      std::copy_backward(leaf->values, leaf->values + leaf->count,
+          leaf->values + leaf->count + 1);
+      leaf->keys[0] = l->keys[l->count - 1];
+      leaf->values[0] = l->values[l->count - 1];
+      parent->keys[i - 1] = leaf->keys[0];
+    } else {
+      // Rotate through the parent: its separator comes down, the left
+      // sibling's last key goes up
+      Inner *l = static_cast<Inner*>(left);
+      Inner *in = static_cast<Inner*>(n);
+      std::copy_backward(in->children, in->children + in->count + 1,
+          in->children + in->count + 2);
+      in->keys[0] = parent->keys[i - 1];
+      in->children[0] = l->children[l->count];
+      parent->keys[i - 1] = l->keys[l->count - 1];
+    }
+    left->count--;
+    n->count++;
+  } else if (right && right->count > kMinKeys) {
+    // Borrow the first entry of the right sibling
+    if (n->is_leaf) {
+      Leaf *r = static_cast<Leaf*>(right);
+      Leaf *leaf = static_cast<Leaf*>(n);
+      leaf->keys[leaf->count] = r->keys[0];
+      leaf->values[leaf->count] = r->values[0];
+      std::copy(r->values + 1, r->values + r->count, r->values);
+      std::copy(r->keys + 1, r->keys + r->count, r->keys);
+      parent->keys[i] = r->keys[0];
+    } else {
+      Inner *r = static_cast<Inner*>(right);
+      Inner *in = static_cast<Inner*>(n);
+      in->keys[in->count] = parent->keys[i];
+      in->children[in->count + 1] = r->children[0];
+      parent->keys[i] = r->keys[0];
+      std::copy(r->keys + 1, r->keys + r->count, r->keys);
+      std::copy(r->children + 1, r->children + r->count + 1, r->children);
+    }
+    right->count--;
+    n->count++;
+  } else if (left) {
+    Merge(parent, i - 1, left, n);
+  } else {
+    Merge(parent, i, n, right);
+  }
+}
+
+template <typename K, typename V>
+void BTreemap<K, V>::Merge(Inner *parent, size_t i, Node *left,
+    Node *right) {
+  if (left->is_leaf) {
+    Leaf *l = static_cast<Leaf*>(left);
+    Leaf *r = static_cast<Leaf*>(right);
+    std::copy(r->keys, r->keys + r->count, l->keys + l->count);
+    std::copy(r->values, r->values + r->count, l->values + l->count);
+    l->count += r->count;
+    l->next = r->next;
+    if (r->next)
+      r->next->prev = l;
+    else
+      tail = l;
+    delete r;
+  } else {
+    // The separator between the two comes down between their keys
+    Inner *l = static_cast<Inner*>(left);
+    Inner *r = static_cast<Inner*>(right);
+    l->keys[l->count] = parent->keys[i];
+    std::copy(r->keys, r->keys + r->count, l->keys + l->count + 1);
+    std::copy(r->children, r->children + r->count + 1,
+        l->children + l->count + 1);
+    l->count += r->count + 1;
+    delete r;
+  }
+  EraseChild(parent, i);
+}
+
+template <typename K, typename V>
+const V& BTreemap<K, V>::Get(const K& key) {
+  if (Empty())
+    throw std::underflow_error("Empty tree");
+  Leaf *leaf = FindLeaf(key, nullptr);
+  size_t pos = LowerBound(leaf, key);
+  if (pos == leaf->count || key < leaf->keys[pos])
+    throw std::invalid_argument("Invalid  key");
+  return leaf->values[pos];
+}
+
+template <typename K, typename V>
+const K& BTreemap<K, V>::FloorKey(const K& key) {
+  if (Empty())
+    throw std::underflow_error("Empty tree");
+  Leaf *leaf = FindLeaf(key, nullptr);
+  size_t pos = UpperBound(leaf, key);
+  if (pos > 0)
+    return leaf->keys[pos - 1];
+  // Every key of this leaf is greater, the floor ends the previous leaf
+  if (!leaf->prev)
+    throw std::out_of_range("Out of range!");
+  return leaf->prev->keys[leaf->prev->count - 1];
+}
+
+template <typename K, typename V>
+const K& BTreemap<K, V>::CeilKey(const K& key) {
+  if (Empty())
+    throw std::underflow_error("Empty tree");
+  Leaf *leaf = FindLeaf(key, nullptr);
+  size_t pos = LowerBound(leaf, key);
+  if (pos < leaf->count)
+    return leaf->keys[pos];
+  // Every key of this leaf is smaller, the ceil starts the next leaf
+  if (!leaf->next)
+    throw std::out_of_range("Out of range!");
+  return leaf->next->keys[0];
+}
+
+template <typename K, typename V>
+bool BTreemap<K, V>::ContainsKey(const K& key) {
+  if (Empty())
+    return false;
+  Leaf *leaf = FindLeaf(key, nullptr);
+  size_t pos = LowerBound(leaf, key);
+  return pos < leaf->count && !(key < leaf->keys[pos]);
+}
+
+template <typename K, typename V>
+bool BTreemap<K, V>::ContainsValue(const V& value) {
+  // Values are scanned leaf by leaf, sequentially in memory
+  for (Leaf *leaf = head; leaf; leaf = leaf->next) {
+    for (size_t i = 0; i < leaf->count; i++) {
+      if (leaf->values[i] == value)
+        return true;
+    }
+  }
+  return false;
+}
+
+template <typename K, typename V>
+const K& BTreemap<K, V>::MaxKey() {
+  if (Empty())
+    throw std::underflow_error("Empty tree");
+  return tail->keys[tail->count - 1];
+}
+
+template <typename K, typename V>
+const K& BTreemap<K, V>::MinKey() {
+  if (Empty())
+    throw std::underflow_error("Empty tree");
+  return head->keys[0];
+}
+
+#endif  // BTREEMAP_H_
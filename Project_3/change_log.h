@@ -0,0 +1,504 @@
+#ifndef CHANGE_LOG_H_
+#define CHANGE_LOG_H_
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "mapped_file.h"
+#include "mapped_treemap.h"
+
+// * Change log files
+// A change log is an append-only file of the insertions and removals made
+// to a map, so that updates are persisted by writing a few bytes instead
+// of the whole map:
+//
+//   header | record | record | ...
+//   record: size (4 bytes) | checksum (4 bytes) | change (1 byte) | key |
+//           value
+//
+// size counts the bytes after the checksum, which covers them, so that a
+// record torn by a crash is detected: replay stops at the first record
+// that is cut short or doesn't match its checksum. Keys are stored as raw
+// bytes and values with SnapshotCodec, as in snapshot files.
+
+enum class Change : uint8_t {
+  kInsert = 1,
+  kRemove = 2
+};
+
+struct ChangeLogHeader {
+  char magic[8];
+  uint64_t key_size;
+};
+
+// File signature, including the format version
+static const char kChangeLogMagic[8] = {
+  'T', 'M', 'A', 'P', 'L', 'O', 'G', '1'
+};
+
+// Return FNV-1a hash of the @size bytes at @data
+inline uint32_t ChangeChecksum(const char *data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; i++)
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+  return hash;
+}
+
+// Return whether a file exists at @path
+inline bool FileExists(const std::string& path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0;
+}
+
+// Flush the file at @path (or the directory, to persist renames in it) to
+// the disk
+// Throws exception if it can't be opened or synced
+inline void SyncPath(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Cannot open file " + path);
+  int synced = fsync(fd);
+  close(fd);
+  if (synced != 0)
+    throw std::runtime_error("Cannot sync file " + path);
+}
+
+// Appends the changes made to a map to a change log file. Records are
+// buffered in memory until flushed.
+template <typename K, typename V>
+class ChangeLog {
+ public:
+  // Constructor/Destructor
+  // Opens the log at @path for appending, creating it if needed. A torn
+  // record left at its end by a crash is cut off
+  // Throws exception if the file can't be opened or is the log of another
+  // key type
+  explicit ChangeLog(const std::string& path);
+  // Flushes the records still buffered
+  ~ChangeLog();
+  ChangeLog(const ChangeLog&) = delete;
+  ChangeLog& operator=(const ChangeLog&) = delete;
+
+  // * Modifiers
+  // Append a record of the insertion/removal of @key and @value
+  // --O(size of value)
+  void Insert(const K& key, const V& value);
+  void Remove(const K& key, const V& value);
+  // Write the buffered records to the file, so that they outlive the
+  // process --O(buffered bytes)
+  // Throws exception if the file can't be written
+  void Flush();
+  // Flush, then wait until the file is on the disk, so that the records
+  // outlive the machine
+  void Sync();
+
+  // Returns number of records in log --O(1)
+  size_t Size() const;
+
+  // Calls @apply(change, key, value) for every record of the log at @path
+  // in order, stopping at a torn or corrupted record; a missing or empty
+  // log has none.
+  // Returns number of records, and stores where the valid part of the
+  // file ends in @valid_bytes if given --O(bytes)
+  // Throws exception if the file is the log of another key type
+  template <typename F>
+  static size_t Replay(const std::string& path, F apply,
+      size_t *valid_bytes = nullptr);
+
+ private:
+  static_assert(std::is_trivially_copyable<K>::value,
+      "Change log keys must be trivially copyable");
+
+  // Bytes before the change of a record: its size and checksum
+  static const size_t kRecordPrefix = 2 * sizeof(uint32_t);
+
+  // Private member variables
+  std::string path;
+  int fd = -1;
+  size_t count = 0;
+  std::string buffer;
+
+  // Private methods
+  void Append(Change change, const K& key, const V& value);
+};
+
+template <typename K, typename V>
+ChangeLog<K, V>::ChangeLog(const std::string& path) : path(path) {
+  size_t valid_bytes = 0;
+  count = Replay(path, [](Change, const K&, const V&) {}, &valid_bytes);
+  fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (fd < 0)
+    throw std::runtime_error("Cannot open file " + path);
+  // A file too short for its header is started again
+  if (valid_bytes == 0) {
+    ChangeLogHeader header;
+    std::memcpy(header.magic, kChangeLogMagic, sizeof(header.magic));
+    header.key_size = sizeof(K);
+    buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+  if (ftruncate(fd, valid_bytes) != 0 ||
+      lseek(fd, valid_bytes, SEEK_SET) < 0) {
+    close(fd);
+    throw std::runtime_error("Cannot truncate file " + path);
+  }
+}
+
+template <typename K, typename V>
+ChangeLog<K, V>::~ChangeLog() {
+  try {
+    Flush();
+  } catch (std::exception&) {
+    // Nothing more can be done for the records
+  }
+  close(fd);
+}
+
+template <typename K, typename V>
+void ChangeLog<K, V>::Insert(const K& key, const V& value) {
+  Append(Change::kInsert, key, value);
+}
+
+template <typename K, typename V>
+void ChangeLog<K, V>::Remove(const K& key, const V& value) {
+  Append(Change::kRemove, key, value);
+}
+
+template <typename K, typename V>
+void ChangeLog<K, V>::Flush() {
+  const char *data = buffer.data();
+  size_t left = buffer.size();
+  while (left > 0) {
+    ssize_t written = write(fd, data, left);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written < 0) {
+      // What was written must not be written again by the next flush
+      buffer.erase(0, data - buffer.data());
+      throw std::runtime_error("Cannot write file " + path);
+    }
+    data += written;
+    left -= written;
+  }
+  buffer.clear();
+}
+
+template <typename K, typename V>
+void ChangeLog<K, V>::Sync() {
+  Flush();
+  if (fdatasync(fd) != 0)
+    throw std::runtime_error("Cannot sync file " + path);
+}
+
+template <typename K, typename V>
+size_t ChangeLog<K, V>::Size() const {
+  return count;
+}
+
+template <typename K, typename V>
+template <typename F>
+size_t ChangeLog<K, V>::Replay(const std::string& path, F apply,
+    size_t *valid_bytes) {
+  if (valid_bytes)
+    *valid_bytes = 0;
+  if (!FileExists(path))
+    return 0;
+  MappedFile file(path, true);
+  const char *data = file.Data();
+  size_t size = file.Size();
+  ChangeLogHeader header;
+  if (size < sizeof(header))
+    return 0;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, kChangeLogMagic, sizeof(header.magic)) != 0 ||
+      header.key_size != sizeof(K))
+    throw std::runtime_error("Invalid change log " + path);
+
+  size_t at = sizeof(header);
+  size_t num_records = 0;
+  while (size - at >= kRecordPrefix) {
+    uint32_t record_size, checksum;
+    std::memcpy(&record_size, data + at, sizeof(record_size));
+    std::memcpy(&checksum, data + at + sizeof(record_size), sizeof(checksum));
+    const char *record = data + at + kRecordPrefix;
+    if (record_size < 1 + sizeof(K) ||
+        record_size > size - at - kRecordPrefix ||
+        ChangeChecksum(record, record_size) != checksum)
+      break;
+    Change change = static_cast<Change>(record[0]);
+    if (change != Change::kInsert && change != Change::kRemove)
+      break;
+    K key;
+    std::memcpy(&key, record + 1, sizeof(K));
+    apply(change, key,
+        SnapshotCodec<V>::Decode(record + 1 + sizeof(K),
+        record_size - 1 - sizeof(K)));
+    at += kRecordPrefix + record_size;
+    num_records++;
+  }
+  if (valid_bytes)
+    *valid_bytes = at;
+  return num_records;
+}
+
+template <typename K, typename V>
+void ChangeLog<K, V>::Append(Change change, const K& key, const V& value) {
+  // The prefix is filled in once the record is encoded after it
+  size_t at = buffer.size();
+  buffer.append(kRecordPrefix, '\0');
+  buffer.push_back(static_cast<char>(change));
+  buffer.append(reinterpret_cast<const char*>(&key), sizeof(K));
+  SnapshotCodec<V>::Append(&buffer, value);
+  uint32_t record_size = buffer.size() - at - kRecordPrefix;
+  uint32_t checksum = ChangeChecksum(buffer.data() + at + kRecordPrefix,
+      record_size);
+  std::memcpy(&buffer[at], &record_size, sizeof(record_size));
+  std::memcpy(&buffer[at + sizeof(record_size)], &checksum, sizeof(checksum));
+  count++;
+}
+
+// * Change log stores
+// A map persisted as a snapshot plus the changes logged since, in files
+// named after a base path:
+//
+//   base           generation of the latest snapshot, as text
+//   base.G.snap    snapshot of generation G (there is none for 0)
+//   base.G.log     changes made after snapshot G was taken
+//
+// Compacting takes a new snapshot of the whole map and starts a new log
+// for the changes that follow. The snapshot is written on a background
+// thread and committed by renaming base, after which the older files are
+// deleted; until then, recovery replays both logs onto the older
+// snapshot, so a crash at any point recovers every change flushed.
+
+template <typename K, typename V>
+class ChangeLogStore {
+ public:
+  // Constructor/Destructor
+  // Opens the store at @base, creating it if needed, and appends changes
+  // to its last log
+  // Throws exception if the files can't be opened or are invalid
+  explicit ChangeLogStore(const std::string& base);
+  // Waits for a compaction in progress
+  ~ChangeLogStore();
+  ChangeLogStore(const ChangeLogStore&) = delete;
+  ChangeLogStore& operator=(const ChangeLogStore&) = delete;
+
+  // * Recovery
+  // Both read the store as it was opened, so are called before changes
+  // Return entries of the latest snapshot, sorted by key --O(N)
+  std::vector<std::pair<K, V>> Snapshot() const;
+  // Calls @apply(change, key, value) for every change logged since the
+  // latest snapshot, in order. Returns number of changes --O(changes)
+  template <typename F>
+  size_t Replay(F apply) const;
+
+  // * Changes
+  // Same as the ChangeLog methods of the same name, on the last log
+  void Insert(const K& key, const V& value);
+  void Remove(const K& key, const V& value);
+  void Flush();
+  void Sync();
+  // Returns number of changes in the last log --O(1)
+  size_t LogSize() const;
+
+  // * Compaction
+  // Starts compacting the store, @entries being the contents of the map
+  // sorted by key. Changes that follow go to a new log, while the
+  // snapshot is written on a background thread --O(1) here, O(N) on the
+  // thread. Waits for the previous compaction first
+  // Throws exception if the new log can't be created, or as Wait()
+  void Compact(std::vector<std::pair<K, V>> entries);
+  // Waits for the compaction in progress, if any, to finish
+  // Throws exception if it failed, leaving the previous snapshot in use
+  void Wait();
+  // Returns generation of the latest committed snapshot --O(1)
+  uint64_t Generation() const;
+
+ private:
+  // Private member variables
+  std::string base;
+  std::atomic<uint64_t> generation{0};
+  // Generation of the last log, which changes are appended to
+  uint64_t log_generation = 0;
+  std::unique_ptr<ChangeLog<K, V>> log;
+  std::thread compaction;
+  std::exception_ptr compaction_error;
+
+  // Private methods
+  std::string SnapshotPath(uint64_t g) const;
+  std::string LogPath(uint64_t g) const;
+  // Writes snapshot @g of @entries and commits it, then deletes the
+  // files of older generations, from @previous on
+  void WriteSnapshot(uint64_t previous, uint64_t g,
+      const std::vector<std::pair<K, V>>& entries);
+};
+
+template <typename K, typename V>
+ChangeLogStore<K, V>::ChangeLogStore(const std::string& base) : base(base) {
+  std::ifstream current(base);
+  uint64_t g = 0;
+  if (current && !(current >> g))
+    throw std::runtime_error("Invalid store " + base);
+  if (g > 0 && !FileExists(SnapshotPath(g)))
+    throw std::runtime_error("Missing snapshot " + SnapshotPath(g));
+  generation = g;
+  // Logs of an unfinished compaction follow the current one
+  log_generation = g;
+  while (FileExists(LogPath(log_generation + 1)))
+    log_generation++;
+  // Files left by a crash: a partial snapshot, or older generations
+  // not deleted yet after a commit (a range ending at g - 1)
+  if (log_generation > g)
+    std::remove((SnapshotPath(log_generation) + ".tmp").c_str());
+  for (uint64_t old = g; old-- > 0;) {
+    bool snapshot = std::remove(SnapshotPath(old).c_str()) == 0;
+    bool old_log = std::remove(LogPath(old).c_str()) == 0;
+    if (!snapshot && !old_log)
+      break;
+  }
+  log.reset(new ChangeLog<K, V>(LogPath(log_generation)));
+}
+
+template <typename K, typename V>
+ChangeLogStore<K, V>::~ChangeLogStore() {
+  if (compaction.joinable())
+    compaction.join();
+}
+
+template <typename K, typename V>
+std::vector<std::pair<K, V>> ChangeLogStore<K, V>::Snapshot() const {
+  std::vector<std::pair<K, V>> entries;
+  if (generation == 0)
+    return entries;
+  MappedTreemap<K, V> snapshot(SnapshotPath(generation));
+  entries.reserve(snapshot.Size());
+  for (size_t i = 0; i < snapshot.Size(); i++)
+    entries.emplace_back(snapshot.Key(i), snapshot.Value(i));
+  return entries;
+}
+
+template <typename K, typename V>
+template <typename F>
+size_t ChangeLogStore<K, V>::Replay(F apply) const {
+  size_t num_changes = 0;
+  for (uint64_t g = generation; g <= log_generation; g++)
+    num_changes += ChangeLog<K, V>::Replay(LogPath(g), apply);
+  return num_changes;
+}
+
+template <typename K, typename V>
+void ChangeLogStore<K, V>::Insert(const K& key, const V& value) {
+  log->Insert(key, value);
+}
+
+template <typename K, typename V>
+void ChangeLogStore<K, V>::Remove(const K& key, const V& value) {
+  log->Remove(key, value);
+}
+
+template <typename K, typename V>
+void ChangeLogStore<K, V>::Flush() {
+  log->Flush();
+}
+
+template <typename K, typename V>
+void ChangeLogStore<K, V>::Sync() {
+  log->Sync();
+}
+
+template <typename K, typename V>
+size_t ChangeLogStore<K, V>::LogSize() const {
+  return log->Size();
+}
+
+template <typename K, typename V>
+void ChangeLogStore<K, V>::Compact(std::vector<std::pair<K, V>> entries) {
+  Wait();
+  // The old log is complete once flushed: recovery replays it until the
+  // snapshot that covers it is committed
+  log->Flush();
+  uint64_t g = log_generation + 1;
+  log.reset(new ChangeLog<K, V>(LogPath(g)));
+  log_generation = g;
+  uint64_t previous = generation;
+  compaction = std::thread([this, previous, g](
+      std::vector<std::pair<K, V>> entries) {
+    try {
+      WriteSnapshot(previous, g, entries);
+    } catch (...) {
+      compaction_error = std::current_exception();
+    }
+  }, std::move(entries));
+}
+
+template <typename K, typename V>
+void ChangeLogStore<K, V>::Wait() {
+  if (compaction.joinable())
+    compaction.join();
+  if (compaction_error) {
+    std::exception_ptr error = compaction_error;
+    compaction_error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+template <typename K, typename V>
+uint64_t ChangeLogStore<K, V>::Generation() const {
+  return generation;
+}
+
+template <typename K, typename V>
+std::string ChangeLogStore<K, V>::SnapshotPath(uint64_t g) const {
+  return base + "." + std::to_string(g) + ".snap";
+}
+
+template <typename K, typename V>
+std::string ChangeLogStore<K, V>::LogPath(uint64_t g) const {
+  return base + "." + std::to_string(g) + ".log";
+}
+
+template <typename K, typename V>
+void ChangeLogStore<K, V>::WriteSnapshot(uint64_t previous, uint64_t g,
+    const std::vector<std::pair<K, V>>& entries) {
+  // Every file reaches the disk before the rename that makes it visible
+  std::string snapshot = SnapshotPath(g);
+  SaveSnapshot(snapshot + ".tmp", entries.begin(), entries.end());
+  SyncPath(snapshot + ".tmp");
+  if (std::rename((snapshot + ".tmp").c_str(), snapshot.c_str()) != 0)
+    throw std::runtime_error("Cannot write snapshot " + snapshot);
+  {
+    std::ofstream current(base + ".tmp", std::ios::trunc);
+    current << g << '\n';
+    if (!current.flush())
+      throw std::runtime_error("Cannot write store " + base);
+  }
+  SyncPath(base + ".tmp");
+  if (std::rename((base + ".tmp").c_str(), base.c_str()) != 0)
+    throw std::runtime_error("Cannot write store " + base);
+  size_t slash = base.rfind('/');
+  SyncPath(slash == std::string::npos ? "." : base.substr(0, slash + 1));
+  generation = g;
+  // In increasing order, so that a crash leaves a range ending at g - 1
+  for (uint64_t old = previous; old < g; old++) {
+    std::remove(SnapshotPath(old).c_str());
+    std::remove(LogPath(old).c_str());
+  }
+}
+
+#endif  // CHANGE_LOG_H_
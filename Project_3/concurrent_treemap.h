@@ -0,0 +1,365 @@
+#ifndef CONCURRENT_TREEMAP_H_
+#define CONCURRENT_TREEMAP_H_
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "node_pool.h"
+#include "path_copy_tree.h"
+
+// Ordered map for read-mostly workloads shared between threads.
+//
+// Readers never block or write shared memory other than their epoch
+// counter: published nodes are immutable, and a writer builds a new copy
+// of the path it changes (O(log N) nodes) before publishing the new root
+// with a single atomic store, so a reader sees either the old or the new
+// version in full. Writers are serialized by a mutex. Replaced nodes are
+// retired and freed in batches, once every reader that could still reach
+// them has left (two-phase epoch counting, as in user-space RCU). Writers
+// only check for that on later writes instead of waiting for it, unless
+// too many retired nodes pile up.
+//
+// Lookups return keys and values by copy, since a reference would not
+// outlive the read.
+template <typename K, typename V>
+class ConcurrentTreemap {
+ public:
+  // Constructor/Destructor
+  ConcurrentTreemap() = default;
+  // No reader or writer may be running
+  ~ConcurrentTreemap();
+  ConcurrentTreemap(const ConcurrentTreemap&) = delete;
+  ConcurrentTreemap& operator=(const ConcurrentTreemap&) = delete;
+
+  // * Capacity (readers)
+  // Returns number of key-value mappings in map --O(1)
+  size_t Size();
+  // Returns true if map is empty --O(1)
+  bool Empty();
+
+  // * Modifiers (writers, serialized)
+  // Inserts @key in map --O(log N)
+  // Throws exception if key already exists
+  void Insert(const K& key, const V& value);
+  // Remove @key from map --O(log N)
+  // Throws exception if key doesn't exists
+  void Remove(const K& key);
+
+  // * Lookup (readers, never block)
+  // Return value corresponding to @key --O(log N)
+  // Throws exception if tree is empty or key doesn't exists
+  V Get(const K& key);
+  // Return greatest key less than or equal to @key --O(log N)
+  // Throws exception if tree is empty or no floor exists for key
+  K FloorKey(const K& key);
+  // Return least key greater than or equal to @key --O(log N)
+  // Throws exception if tree is empty or no ceil exists for key
+  K CeilKey(const K& key);
+  // Return whether @key is found in map --O(log N)
+  bool ContainsKey(const K& key);
+  // Return max/min key in map --O(log N)
+  // Throws exception if tree is empty
+  K MaxKey();
+  K MinKey();
+
+  // Call @callback(key, value) on every entry with @lo <= key <= @hi in
+  // increasing key order, all from the same version of the map
+  // --O(log N + number of entries visited)
+  template <typename F>
+  void Range(const K& lo, const K& hi, F callback);
+
+ private:
+  // Private types
+  // Nodes are never modified once reachable from the published root; the
+  // map frees them (see Retire)
+  typedef PathCopyTree<K, V, RawPtr> Tree;
+  typedef typename Tree::Node Node;
+  // Updates call Make and Retire
+  friend struct PathCopyTree<K, V, RawPtr>;
+  // Reader counters for the two epoch parities, one cache line per slot
+  // so that readers on different slots don't contend
+  struct alignas(64) ReaderSlot {
+    std::atomic<size_t> active[2];
+  };
+  // Counts the calling thread as a reader for its lifetime
+  class ReadSection;
+
+  // Private constants
+  static const size_t kReaderSlots = 64;
+  // Number of retired nodes that starts a grace period
+  static const size_t kReclaimBatch = 4096;
+  // Number of retired nodes past which a writer waits for readers
+  static const size_t kMaxRetired = 16 * kReclaimBatch;
+
+  // Private member variables
+  std::atomic<const Node*> root{nullptr};
+  std::atomic<unsigned> epoch{0};
+  ReaderSlot slots[kReaderSlots] = {};
+  // Writer state
+  std::mutex writer;
+  // Nodes retired since the current grace period started, and nodes
+  // waiting for it to end
+  std::vector<const Node*> retired;
+  std::vector<const Node*> pending;
+  // Grace period phase (0 if none), and epoch parity being drained
+  int phase = 0;
+  unsigned draining = 0;
+  NodePool<Node> pool;
+
+  // Private methods
+  // Return the slot of the calling thread
+  ReaderSlot& Slot();
+
+  // * Node management for the path copying updates, called by the writer
+  const Node *Make(const K& key, const V& value, const Node *left,
+      const Node *right);
+  // Marks a node replaced by a new version
+  void Retire(const Node *n);
+  // Makes @new_root the current version and advances reclamation
+  void Publish(const Node *new_root);
+  // Flips the epoch, to wait for the readers of the previous parity
+  void StartPhase();
+  // Return whether no reader is counted under parity @draining
+  bool Drained();
+  void Free(const Node *n);
+};
+
+template <typename K, typename V>
+class ConcurrentTreemap<K, V>::ReadSection {
+ public:
+  explicit ReadSection(ConcurrentTreemap& map)
+      : counter(map.Slot().active[map.epoch.load() & 1]) {
+    counter.fetch_add(1);
+  }
+  ~ReadSection() {
+    counter.fetch_sub(1);
+  }
+
+ private:
+  std::atomic<size_t>& counter;
+};
+
+template <typename K, typename V>
+ConcurrentTreemap<K, V>::~ConcurrentTreemap() {
+  std::vector<const Node*> stack;
+  if (root.load())
+    stack.push_back(root.load());
+  while (!stack.empty()) {
+    const Node *n = stack.back();
+    stack.pop_back();
+    if (n->left)
+      stack.push_back(n->left);
+    if (n->right)
+      stack.push_back(n->right);
+    Free(n);
+  }
+  for (const Node *n : retired)
+    Free(n);
+  for (const Node *n : pending)
+    Free(n);
+}
+
+template <typename K, typename V>
+size_t ConcurrentTreemap<K, V>::Size() {
+  ReadSection read(*this);
+  return Tree::SizeOf(root.load());
+}
+
+template <typename K, typename V>
+bool ConcurrentTreemap<K, V>::Empty() {
+  return Size() == 0;
+}
+
+template <typename K, typename V>
+void ConcurrentTreemap<K, V>::Insert(const K& key, const V& value) {
+  std::lock_guard<std::mutex> lock(writer);
+  const Node *old_root = root.load();
+  if (Tree::FindNode(old_root, key))
+    throw std::invalid_argument("Duplicate Key");
+  size_t mark = retired.size();
+  const Node *new_root;
+  try {
+    new_root = Tree::InsertAt(*this, old_root, key, value);
+  } catch (...) {
+    // The old version stays published; its nodes must not be freed
+    retired.resize(mark);
+    throw;
+  }
+  Publish(new_root);
+}
+
+template <typename K, typename V>
+void ConcurrentTreemap<K, V>::Remove(const K& key) {
+  std::lock_guard<std::mutex> lock(writer);
+  const Node *old_root = root.load();
+  if (!Tree::FindNode(old_root, key))
+    throw std::invalid_argument("Invalid  key");
+  size_t mark = retired.size();
+  const Node *new_root;
+  try {
+    new_root = Tree::RemoveAt(*this, old_root, key);
+  } catch (...) {
+    // The old version stays published; its nodes must not be freed
+    retired.resize(mark);
+    throw;
+  }
+  Publish(new_root);
+}
+
+template <typename K, typename V>
+V ConcurrentTreemap<K, V>::Get(const K& key) {
+  ReadSection read(*this);
+  const Node *n = root.load();
+  if (!n)
+    throw std::underflow_error("Empty tree");
+  n = Tree::FindNode(n, key);
+  if (!n)
+    throw std::invalid_argument("Invalid  key");
+  return n->value;
+}
+
+template <typename K, typename V>
+K ConcurrentTreemap<K, V>::FloorKey(const K& key) {
+  ReadSection read(*this);
+  const Node *n = root.load();
+  if (!n)
+    throw std::underflow_error("Empty tree");
+  n = Tree::FloorNode(n, key);
+  if (!n)
+    throw std::out_of_range("Out of range!");
+  return n->key;
+}
+
+template <typename K, typename V>
+K ConcurrentTreemap<K, V>::CeilKey(const K& key) {
+  ReadSection read(*this);
+  const Node *n = root.load();
+  if (!n)
+    throw std::underflow_error("Empty tree");
+  n = Tree::CeilNode(n, key);
+  if (!n)
+    throw std::out_of_range("Out of range!");
+  return n->key;
+}
+
+template <typename K, typename V>
+bool ConcurrentTreemap<K, V>::ContainsKey(const K& key) {
+  ReadSection read(*this);
+  return Tree::FindNode(root.load(), key) != nullptr;
+}
+
+template <typename K, typename V>
+K ConcurrentTreemap<K, V>::MaxKey() {
+  ReadSection read(*this);
+  const Node *n = root.load();
+  if (!n)
+    throw std::underflow_error("Empty tree");
+  while (n->right)
+    n = n->right;
+  return n->key;
+}
+
+template <typename K, typename V>
+K ConcurrentTreemap<K, V>::MinKey() {
+  ReadSection read(*this);
+  const Node *n = root.load();
+  if (!n)
+    throw std::underflow_error("Empty tree");
+  while (n->left)
+    n = n->left;
+  return n->key;
+}
+
+template <typename K, typename V>
+template <typename F>
+void ConcurrentTreemap<K, V>::Range(const K& lo, const K& hi, F callback) {
+  ReadSection read(*this);
+  Tree::RangeOf(root.load(), lo, hi, callback);
+}
+
+template <typename K, typename V>
+typename ConcurrentTreemap<K, V>::ReaderSlot& ConcurrentTreemap<K, V>::Slot() {
+  // Threads are spread over the slots round-robin on first use
+  static std::atomic<size_t> next_slot{0};
+  static thread_local size_t slot = next_slot.fetch_add(1) % kReaderSlots;
+  return slots[slot];
+}
+
+template <typename K, typename V>
+const typename ConcurrentTreemap<K, V>::Node *ConcurrentTreemap<K, V>::Make(
+    const K& key, const V& value, const Node *left, const Node *right) {
+  Node *n = pool.allocate(1);
+  try {
+    new (n) Node(key, value, left, right);
+  } catch (...) {
+    pool.deallocate(n, 1);
+    throw;
+  }
+  return n;
+}
+
+template <typename K, typename V>
+void ConcurrentTreemap<K, V>::Retire(const Node *n) {
+  retired.push_back(n);
+}
+
+template <typename K, typename V>
+void ConcurrentTreemap<K, V>::Publish(const Node *new_root) {
+  root.store(new_root);
+
+  // A reader counted under one parity may have loaded any root published
+  // before its counter was incremented. Once the pending nodes are
+  // unlinked, flipping the epoch twice and draining the old parity each
+  // time outlasts every reader that could reach them; later readers only
+  // see newer roots.
+  if (phase == 0) {
+    if (retired.size() < kReclaimBatch)
+      return;
+    pending.swap(retired);
+    StartPhase();
+    phase = 1;
+    return;
+  }
+  if (!Drained()) {
+    if (retired.size() < kMaxRetired)
+      return;
+    while (!Drained())
+      std::this_thread::yield();
+  }
+  if (phase == 1) {
+    StartPhase();
+    phase = 2;
+    return;
+  }
+  for (const Node *n : pending)
+    Free(n);
+  pending.clear();
+  phase = 0;
+}
+
+template <typename K, typename V>
+void ConcurrentTreemap<K, V>::StartPhase() {
+  draining = epoch.fetch_add(1) & 1;
+}
+
+template <typename K, typename V>
+bool ConcurrentTreemap<K, V>::Drained() {
+  for (size_t i = 0; i < kReaderSlots; i++) {
+    if (slots[i].active[draining].load())
+      return false;
+  }
+  return true;
+}
+
+template <typename K, typename V>
+void ConcurrentTreemap<K, V>::Free(const Node *n) {
+  Node *node = const_cast<Node*>(n);
+  node->~Node();
+  pool.deallocate(node, 1);
+}
+
+#endif  // CONCURRENT_TREEMAP_H_
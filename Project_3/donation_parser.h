@@ -0,0 +1,149 @@
+#ifndef DONATION_PARSER_H_
+#define DONATION_PARSER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// One "name,amount" row, with the amount in cents; the name is a range
+// of the parser's arena
+struct DonationRow {
+  int64_t amount;
+  uint32_t name_size;
+  size_t name_offset;
+};
+
+// Parser for donation files, one "name,amount" row per line.
+//
+// Works on a buffer holding the whole file (such as a MappedFile) instead
+// of reading line by line: memchr finds the line and field separators,
+// amounts are converted in place, and names are copied back to back into
+// a single string arena rather than into one std::string each, so a row
+// costs no allocation of its own.
+class DonationParser {
+ public:
+  // Parses every row of [@begin, @end), appending them to Rows() in file
+  // order --O(bytes). Empty lines are skipped, a '\r' ending a line is
+  // ignored, and the name stops at the first ','
+  // Throws exception if a row has no ',' or no valid amount
+  void Parse(const char *begin, const char *end);
+
+  // Return parsed rows --O(1)
+  // They may be reordered (e.g. sorted) without affecting their names
+  const std::vector<DonationRow>& Rows() const {
+    return rows;
+  }
+  std::vector<DonationRow>& Rows() {
+    return rows;
+  }
+  // Return name of @row --O(length of the name)
+  std::string Name(const DonationRow& row) const {
+    return std::string(arena.data() + row.name_offset, row.name_size);
+  }
+
+  // Converts the amount starting [@begin, @end) to cents. Leading blanks,
+  // a sign and up to two decimals ("12", "-3.5", "0.25") are accepted;
+  // like std::stoi, anything after the number is ignored --O(length)
+  // Throws exception if there are no digits, more than two decimals, or
+  // the amount overflows int64_t
+  static int64_t ParseCents(const char *begin, const char *end);
+
+  // Return @num_chunks + 1 positions splitting [@begin, @end) into about
+  // equal chunks of whole lines, so that each chunk can be parsed by a
+  // different thread: chunk i is [cuts[i], cuts[i + 1]) --O(num_chunks +
+  // length of the lines cut). Chunks may be empty
+  static std::vector<const char*> SplitLines(const char *begin,
+      const char *end, size_t num_chunks);
+
+ private:
+  std::vector<DonationRow> rows;
+  std::string arena;
+};
+
+inline void DonationParser::Parse(const char *begin, const char *end) {
+  // Names never take more room than the buffer they come from
+  arena.reserve(arena.size() + (end - begin));
+  const char *line = begin;
+  while (line < end) {
+    const char *eol = static_cast<const char*>(
+        std::memchr(line, '\n', end - line));
+    if (!eol)
+      eol = end;
+    if (eol != line) {
+      const char *comma = static_cast<const char*>(
+          std::memchr(line, ',', eol - line));
+      if (!comma)
+        throw std::invalid_argument("Missing ',' in row " +
+            std::string(line, eol));
+      DonationRow row;
+      row.amount = ParseCents(comma + 1, eol);
+      row.name_size = comma - line;
+      row.name_offset = arena.size();
+      arena.append(line, comma);
+      rows.push_back(row);
+    }
+    line = eol + 1;
+  }
+}
+
+inline int64_t DonationParser::ParseCents(const char *begin,
+    const char *end) {
+  const char *p = begin;
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    p++;
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-'))
+    negative = *p++ == '-';
+  // Accumulated as a magnitude, which may reach one past INT64_MAX
+  const uint64_t limit =
+      static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + negative;
+  uint64_t value = 0;
+  size_t num_digits = 0;
+  auto push = [&](unsigned digit) {
+    if (value > (limit - digit) / 10)
+      throw std::out_of_range("Amount out of range " +
+          std::string(begin, end));
+    value = value * 10 + digit;
+  };
+  for (; p < end && static_cast<unsigned>(*p - '0') <= 9; p++, num_digits++)
+    push(*p - '0');
+  // Cents are the first two decimals, zero if missing
+  bool point = p < end && *p == '.';
+  p += point;
+  for (int i = 0; i < 2; i++) {
+    bool digit = point && p < end && static_cast<unsigned>(*p - '0') <= 9;
+    push(digit ? *p++ - '0' : 0);
+    num_digits += digit;
+  }
+  if (!num_digits)
+    throw std::invalid_argument("Invalid amount " + std::string(begin, end));
+  if (point && p < end && static_cast<unsigned>(*p - '0') <= 9)
+    throw std::invalid_argument("More than two decimals in amount " +
+        std::string(begin, end));
+  return negative ? static_cast<int64_t>(0 - value)
+      : static_cast<int64_t>(value);
+}
+
+inline std::vector<const char*> DonationParser::SplitLines(
+    const char *begin, const char *end, size_t num_chunks) {
+  std::vector<const char*> cuts(1, begin);
+  size_t chunk = (end - begin) / num_chunks;
+  for (size_t i = 1; i < num_chunks; i++) {
+    // Each cut moves forward to the start of the next line
+    const char *cut = std::max(cuts.back(), begin + i * chunk);
+    if (cut != begin && cut < end && cut[-1] != '\n') {
+      cut = static_cast<const char*>(std::memchr(cut, '\n', end - cut));
+      cut = cut ? cut + 1 : end;
+    }
+    cuts.push_back(cut);
+  }
+  cuts.push_back(end);
+  return cuts;
+}
+
+#endif  // DONATION_PARSER_H_
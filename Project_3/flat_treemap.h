@@ -0,0 +1,241 @@
+#ifndef FLAT_TREEMAP_H_
+#define FLAT_TREEMAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+// Read-only ordered map for load-once, query-many workloads, with the
+// lookup API of Treemap and the positional API of MappedTreemap.
+//
+// Entries are kept sorted in separate key and value arrays, so that
+// searches only touch keys. Searches run on a second copy of the keys in
+// Eytzinger (breadth-first) order: the node at index k has its children
+// at 2k and 2k + 1, so the first levels of every search share a few
+// cache lines, and the loop prefetches the descendants it will visit
+// four levels down. The search is branch-free, always taking
+// floor(log2 N) + 1 steps. Keys may repeat (as in a TreeMultimap).
+template <typename K, typename V>
+class FlatTreemap {
+ public:
+  // Constructor
+  FlatTreemap() = default;
+
+  // * Capacity
+  // Returns number of key-value mappings in map --O(1)
+  size_t Size() const;
+  // Returns true if map is empty --O(1)
+  bool Empty() const;
+
+  // * Modifiers
+  // Replace contents with the (key, value) pairs in [first, last), which
+  // must be sorted by non-decreasing key --O(N)
+  // Throws exception (leaving map unchanged) if keys are out of order
+  template <typename It>
+  void BuildFromSorted(It first, It last);
+  // Same as above for every pair of @range
+  template <typename R>
+  void BuildFromSorted(const R& range);
+  // Remove all entries --O(N)
+  void Clear();
+
+  // * Lookup
+  // Return (first) value corresponding to @key --O(log N)
+  // Throws exception if tree is empty or key doesn't exists
+  const V& Get(const K& key) const;
+  // Return greatest key less than or equal to @key --O(log N)
+  // Throws exception if tree is empty or no floor exists for key
+  const K& FloorKey(const K& key) const;
+  // Return least key greater than or equal to @key --O(log N)
+  // Throws exception if tree is empty or no ceil exists for key
+  const K& CeilKey(const K& key) const;
+  // Return whether @key is found in map --O(log N)
+  bool ContainsKey(const K& key) const;
+  // Return max/min key in map --O(1)
+  // Throws exception if tree is empty
+  const K& MaxKey() const;
+  const K& MinKey() const;
+
+  // * Positional access
+  // Return key/value of the @i-th entry in key order, counting from 0
+  // --O(1), @i must be less than Size()
+  const K& Key(size_t i) const;
+  const V& Value(size_t i) const;
+  // Return index of the first entry whose key is not less than (lower)
+  // or greater than (upper) @key, Size() if none --O(log N)
+  size_t LowerBound(const K& key) const;
+  size_t UpperBound(const K& key) const;
+
+ private:
+  // Keys that fit in a cache line, which is how far ahead (in Eytzinger
+  // indexes) a search prefetches
+  static const size_t kLineKeys = sizeof(K) < 64 ? 64 / sizeof(K) : 1;
+
+  // Private member variables
+  std::vector<K> keys;
+  std::vector<V> values;
+  // Eytzinger copy of the keys, from index 1, with the position of each
+  // in key order
+  std::vector<K> search_keys;
+  std::vector<size_t> search_ranks;
+
+  // Private methods
+  // Fills the Eytzinger subtree rooted at @k with the sorted keys from
+  // position @i on, returning the position after the last one used
+  size_t FillSearch(size_t i, size_t k);
+  // Return position in key order of the Eytzinger index @k where a
+  // search ended (the last node it went left from), Size() if none
+  size_t RankOf(size_t k) const;
+};
+
+template <typename K, typename V>
+size_t FlatTreemap<K, V>::Size() const {
+  return keys.size();
+}
+
+template <typename K, typename V>
+bool FlatTreemap<K, V>::Empty() const {
+  return keys.empty();
+}
+
+template <typename K, typename V>
+template <typename It>
+void FlatTreemap<K, V>::BuildFromSorted(It first, It last) {
+  std::vector<K> new_keys;
+  std::vector<V> new_values;
+  for (It it = first; it != last; ++it) {
+    if (!new_keys.empty() && it->first < new_keys.back())
+      throw std::invalid_argument("Unsorted keys");
+    new_keys.push_back(it->first);
+    new_values.push_back(it->second);
+  }
+  keys.swap(new_keys);
+  values.swap(new_values);
+  search_keys.assign(keys.size() + 1, K());
+  search_ranks.assign(keys.size() + 1, 0);
+  FillSearch(0, 1);
+}
+
+template <typename K, typename V>
+template <typename R>
+void FlatTreemap<K, V>::BuildFromSorted(const R& range) {
+  BuildFromSorted(std::begin(range), std::end(range));
+}
+
+template <typename K, typename V>
+void FlatTreemap<K, V>::Clear() {
+  keys.clear();
+  values.clear();
+  search_keys.clear();
+  search_ranks.clear();
+}
+
+template <typename K, typename V>
+const V& FlatTreemap<K, V>::Get(const K& key) const {
+  if (keys.empty())
+    throw std::underflow_error("Empty tree");
+  size_t i = LowerBound(key);
+  if (i == keys.size() || key < keys[i])
+    throw std::invalid_argument("Invalid  key");
+  return values[i];
+}
+
+template <typename K, typename V>
+const K& FlatTreemap<K, V>::FloorKey(const K& key) const {
+  if (keys.empty())
+    throw std::underflow_error("Empty tree");
+  size_t i = UpperBound(key);
+  if (i == 0)
+    throw std::out_of_range("Out of range!");
+  return keys[i - 1];
+}
+
+template <typename K, typename V>
+const K& FlatTreemap<K, V>::CeilKey(const K& key) const {
+  if (keys.empty())
+    throw std::underflow_error("Empty tree");
+  size_t i = LowerBound(key);
+  if (i == keys.size())
+    throw std::out_of_range("Out of range!");
+  return keys[i];
+}
+
+template <typename K, typename V>
+bool FlatTreemap<K, V>::ContainsKey(const K& key) const {
+  size_t i = LowerBound(key);
+  return i < keys.size() && !(key < keys[i]);
+}
+
+template <typename K, typename V>
+const K& FlatTreemap<K, V>::MaxKey() const {
+  if (keys.empty())
+    throw std::underflow_error("Empty tree");
+  return keys.back();
+}
+
+template <typename K, typename V>
+const K& FlatTreemap<K, V>::MinKey() const {
+  if (keys.empty())
+    throw std::underflow_error("Empty tree");
+  return keys.front();
+}
+
+template <typename K, typename V>
+const K& FlatTreemap<K, V>::Key(size_t i) const {
+  return keys[i];
+}
+
+template <typename K, typename V>
+const V& FlatTreemap<K, V>::Value(size_t i) const {
+  return values[i];
+}
+
+template <typename K, typename V>
+size_t FlatTreemap<K, V>::LowerBound(const K& key) const {
+  // Go right past every key less than @key; the answer is the last node
+  // the search went left from
+  const K *search = search_keys.data();
+  size_t n = keys.size();
+  size_t k = 1;
+  while (k <= n) {
+    __builtin_prefetch(search + std::min(k * kLineKeys, n));
+    k = 2 * k + (search[k] < key);
+  }
+  return RankOf(k);
+}
+
+template <typename K, typename V>
+size_t FlatTreemap<K, V>::UpperBound(const K& key) const {
+  const K *search = search_keys.data();
+  size_t n = keys.size();
+  size_t k = 1;
+  while (k <= n) {
+    __builtin_prefetch(search + std::min(k * kLineKeys, n));
+    k = 2 * k + !(key < search[k]);
+  }
+  return RankOf(k);
+}
+
+template <typename K, typename V>
+size_t FlatTreemap<K, V>::FillSearch(size_t i, size_t k) {
+  // In-order walk of the implicit tree, whose depth is log2(N)
+  if (k <= keys.size()) {
+    i = FillSearch(i, 2 * k);
+    search_keys[k] = keys[i];
+    search_ranks[k] = i++;
+    i = FillSearch(i, 2 * k + 1);
+  }
+  return i;
+}
+
+template <typename K, typename V>
+size_t FlatTreemap<K, V>::RankOf(size_t k) const {
+  // The path is written in the bits of @k (1 for right); dropping the
+  // trailing right turns and the last left turn gives the node
+  k >>= __builtin_ctzll(~static_cast<unsigned long long>(k)) + 1;
+  return k ? search_ranks[k] : keys.size();
+}
+
+#endif  // FLAT_TREEMAP_H_
@@ -0,0 +1,71 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+// Read-only memory mapping of a whole file, unmapped on destruction.
+// Pages are only read from disk as they are touched.
+class MappedFile {
+ public:
+  // Constructor/Destructor
+  // Maps the file at @path; @sequential hints that it will be read once
+  // from start to end, so the OS can read ahead aggressively
+  // Throws exception if the file can't be opened or mapped
+  explicit MappedFile(const std::string& path, bool sequential = false);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Return contents of the file, nullptr if it is empty --O(1)
+  const char *Data() const {
+    return data;
+  }
+  // Return size of the file in bytes --O(1)
+  size_t Size() const {
+    return size;
+  }
+
+ private:
+  const char *data = nullptr;
+  size_t size = 0;
+};
+
+inline MappedFile::MappedFile(const std::string& path, bool sequential) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Cannot open file " + path);
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    throw std::runtime_error("Cannot open file " + path);
+  }
+  // An empty file can't be mapped, and has nothing to map anyway
+  if (info.st_size > 0) {
+    void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd,
+        0);
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("Cannot map file " + path);
+    }
+    data = static_cast<const char*>(mapping);
+    size = info.st_size;
+    if (sequential)
+      madvise(mapping, size, MADV_SEQUENTIAL);
+  }
+  // The mapping stays valid once the file is closed
+  close(fd);
+}
+
+inline MappedFile::~MappedFile() {
+  if (data)
+    munmap(const_cast<char*>(data), size);
+}
+
+#endif  // MAPPED_FILE_H_
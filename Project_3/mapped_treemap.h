@@ -0,0 +1,329 @@
+#ifndef MAPPED_TREEMAP_H_
+#define MAPPED_TREEMAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "mapped_file.h"
+#include "treemap.h"
+
+// * Snapshot files
+// A snapshot stores the entries of a map sorted by key, so that it can
+// be queried in place once mapped into memory:
+//
+//   header | keys[count] (padded to 8 bytes) | offsets[count + 1] | pool
+//
+// Keys are stored as raw bytes and must be trivially copyable. Value i is
+// the byte range [offsets[i], offsets[i + 1]) of the pool, encoded by
+// SnapshotCodec. Keys may repeat (as in a TreeMultimap). Integers are in
+// the byte order of the machine that wrote the file.
+
+struct SnapshotHeader {
+  char magic[8];
+  uint64_t count;
+  uint64_t key_size;
+  uint64_t pool_size;
+};
+
+// File signature, including the format version
+static const char kSnapshotMagic[8] = {
+  'T', 'M', 'A', 'P', 'S', 'N', 'P', '1'
+};
+
+// Default value encoding: the bytes of a trivially copyable value
+template <typename V>
+struct SnapshotCodec {
+  static_assert(std::is_trivially_copyable<V>::value,
+      "Snapshot values must be trivially copyable or std::string");
+  static void Append(std::string *pool, const V& value) {
+    pool->append(reinterpret_cast<const char*>(&value), sizeof(V));
+  }
+  static V Decode(const char *bytes, size_t) {
+    V value;
+    std::memcpy(&value, bytes, sizeof(V));
+    return value;
+  }
+};
+
+// Strings are stored as their characters
+template <>
+struct SnapshotCodec<std::string> {
+  static void Append(std::string *pool, const std::string& value) {
+    pool->append(value);
+  }
+  static std::string Decode(const char *bytes, size_t size) {
+    return std::string(bytes, size);
+  }
+};
+
+// Write the (key, value) pairs of [first, last), sorted by non-decreasing
+// key, to a snapshot file at @path --O(N)
+// Throws exception if keys are out of order or the file can't be written
+template <typename It>
+void SaveSnapshot(const std::string& path, It first, It last);
+
+// Write every entry of @map to a snapshot file at @path --O(N)
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void SaveSnapshot(const std::string& path, Treemap<K, V, A, C, Alloc>& map) {
+  SaveSnapshot(path, map.begin(), map.end());
+}
+
+// Return whether the file at @path starts like a snapshot
+inline bool IsSnapshot(const std::string& path) {
+  char magic[sizeof(kSnapshotMagic)];
+  std::ifstream file(path, std::ios::binary);
+  return file.read(magic, sizeof(magic)) &&
+      std::memcmp(magic, kSnapshotMagic, sizeof(magic)) == 0;
+}
+
+// Read-only ordered map answering queries straight from a memory-mapped
+// snapshot file, with no parsing or allocation when loading: the OS pages
+// in what lookups touch. Entries are also addressable by their index in
+// key order. Values are decoded (copied) on access.
+template <typename K, typename V>
+class MappedTreemap {
+ public:
+  // Constructor/Destructor
+  // Maps the snapshot file at @path
+  // Throws exception if the file can't be mapped or isn't a valid
+  // snapshot of this key type --O(N)
+  explicit MappedTreemap(const std::string& path);
+  MappedTreemap(const MappedTreemap&) = delete;
+  MappedTreemap& operator=(const MappedTreemap&) = delete;
+
+  // * Capacity
+  // Returns number of key-value mappings in map --O(1)
+  size_t Size() const;
+  // Returns true if map is empty --O(1)
+  bool Empty() const;
+
+  // * Lookup
+  // Return (first) value corresponding to @key --O(log N)
+  // Throws exception if tree is empty or key doesn't exists
+  V Get(const K& key) const;
+  // Return greatest key less than or equal to @key --O(log N)
+  // Throws exception if tree is empty or no floor exists for key
+  const K& FloorKey(const K& key) const;
+  // Return least key greater than or equal to @key --O(log N)
+  // Throws exception if tree is empty or no ceil exists for key
+  const K& CeilKey(const K& key) const;
+  // Return whether @key is found in map --O(log N)
+  bool ContainsKey(const K& key) const;
+  // Return max/min key in map --O(1)
+  // Throws exception if tree is empty
+  const K& MaxKey() const;
+  const K& MinKey() const;
+
+  // * Positional access
+  // Return key/value of the @i-th entry in key order, counting from 0
+  // --O(1), @i must be less than Size()
+  const K& Key(size_t i) const;
+  V Value(size_t i) const;
+  // Return index of the first entry whose key is not less than (lower)
+  // or greater than (upper) @key, Size() if none --O(log N)
+  size_t LowerBound(const K& key) const;
+  size_t UpperBound(const K& key) const;
+
+ private:
+  static_assert(std::is_trivially_copyable<K>::value,
+      "Snapshot keys must be trivially copyable");
+
+  // Private member variables
+  MappedFile file;
+  size_t count = 0;
+  const K *keys = nullptr;
+  const uint64_t *offsets = nullptr;
+  const char *pool = nullptr;
+};
+
+// Return @size rounded up to a multiple of 8
+inline size_t SnapshotPad(size_t size) {
+  return (size + 7) & ~static_cast<size_t>(7);
+}
+
+template <typename It>
+void SaveSnapshot(const std::string& path, It first, It last) {
+  typedef typename std::decay<decltype(first->first)>::type K;
+  typedef typename std::decay<decltype(first->second)>::type V;
+  static_assert(std::is_trivially_copyable<K>::value,
+      "Snapshot keys must be trivially copyable");
+
+  std::vector<K> keys;
+  std::vector<uint64_t> offsets(1, 0);
+  std::string pool;
+  for (; first != last; ++first) {
+    if (!keys.empty() && first->first < keys.back())
+      throw std::invalid_argument("Unsorted keys");
+    keys.push_back(first->first);
+    SnapshotCodec<V>::Append(&pool, first->second);
+    offsets.push_back(pool.size());
+  }
+
+  SnapshotHeader header;
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+  header.count = keys.size();
+  header.key_size = sizeof(K);
+  header.pool_size = pool.size();
+  size_t keys_bytes = keys.size() * sizeof(K);
+  static const char kPadding[8] = {};
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(keys.data()), keys_bytes);
+  file.write(kPadding, SnapshotPad(keys_bytes) - keys_bytes);
+  file.write(reinterpret_cast<const char*>(offsets.data()),
+      offsets.size() * sizeof(uint64_t));
+  file.write(pool.data(), pool.size());
+  if (!file)
+    throw std::runtime_error("Cannot write snapshot " + path);
+}
+
+template <typename K, typename V>
+MappedTreemap<K, V>::MappedTreemap(const std::string& path) : file(path) {
+  // Check that every section fits before pointing into it
+  const char *base = file.Data();
+  size_t size = file.Size();
+  SnapshotHeader header;
+  bool valid = size >= sizeof(header);
+  if (valid) {
+    std::memcpy(&header, base, sizeof(header));
+    valid = std::memcmp(header.magic, kSnapshotMagic,
+        sizeof(header.magic)) == 0 && header.key_size == sizeof(K);
+  }
+  // The sizes in the header are checked against what is left of the file
+  // before being added, so that a corrupted header can't wrap around
+  size_t keys_at = sizeof(header);
+  size_t offsets_at = 0;
+  size_t pool_at = 0;
+  if (valid)
+    valid = header.count <= (size - keys_at) / sizeof(K);
+  if (valid) {
+    count = header.count;
+    offsets_at = keys_at + SnapshotPad(count * sizeof(K));
+    valid = offsets_at <= size &&
+        count < (size - offsets_at) / sizeof(uint64_t);
+  }
+  if (valid) {
+    pool_at = offsets_at + (count + 1) * sizeof(uint64_t);
+    valid = header.pool_size == size - pool_at;
+  }
+  if (valid) {
+    // Values must split the pool exactly, so that none reaches past it
+    offsets = reinterpret_cast<const uint64_t*>(base + offsets_at);
+    valid = offsets[0] == 0 && offsets[count] == header.pool_size;
+    for (size_t i = 0; valid && i < count; i++)
+      valid = offsets[i] <= offsets[i + 1];
+  }
+  if (!valid)
+    throw std::runtime_error("Invalid snapshot " + path);
+  keys = reinterpret_cast<const K*>(base + keys_at);
+  pool = base + pool_at;
+}
+
+template <typename K, typename V>
+size_t MappedTreemap<K, V>::Size() const {
+  return count;
+}
+
+template <typename K, typename V>
+bool MappedTreemap<K, V>::Empty() const {
+  return count == 0;
+}
+
+template <typename K, typename V>
+V MappedTreemap<K, V>::Get(const K& key) const {
+  if (!count)
+    throw std::underflow_error("Empty tree");
+  size_t i = LowerBound(key);
+  if (i == count || key < keys[i])
+    throw std::invalid_argument("Invalid  key");
+  return Value(i);
+}
+
+template <typename K, typename V>
+const K& MappedTreemap<K, V>::FloorKey(const K& key) const {
+  if (!count)
+    throw std::underflow_error("Empty tree");
+  size_t i = UpperBound(key);
+  if (i == 0)
+    throw std::out_of_range("Out of range!");
+  return keys[i - 1];
+}
+
+template <typename K, typename V>
+const K& MappedTreemap<K, V>::CeilKey(const K& key) const {
+  if (!count)
+    throw std::underflow_error("Empty tree");
+  size_t i = LowerBound(key);
+  if (i == count)
+    throw std::out_of_range("Out of range!");
+  return keys[i];
+}
+
+template <typename K, typename V>
+bool MappedTreemap<K, V>::ContainsKey(const K& key) const {
+  size_t i = LowerBound(key);
+  return i < count && !(key < keys[i]);
+}
+
+template <typename K, typename V>
+const K& MappedTreemap<K, V>::MaxKey() const {
+  if (!count)
+    throw std::underflow_error("Empty tree");
+  return keys[count - 1];
+}
+
+template <typename K, typename V>
+const K& MappedTreemap<K, V>::MinKey() const {
+  if (!count)
+    throw std::underflow_error("Empty tree");
+  return keys[0];
+}
+
+template <typename K, typename V>
+const K& MappedTreemap<K, V>::Key(size_t i) const {
+  return keys[i];
+}
+
+template <typename K, typename V>
+V MappedTreemap<K, V>::Value(size_t i) const {
+  return SnapshotCodec<V>::Decode(pool + offsets[i],
+      offsets[i + 1] - offsets[i]);
+}
+
+template <typename K, typename V>
+size_t MappedTreemap<K, V>::LowerBound(const K& key) const {
+  // Branch-free binary search: the range halves every step whatever the
+  // comparison says, so the loop has a fixed trip count for a given size
+  if (!count)
+    return 0;
+  const K *base = keys;
+  size_t n = count;
+  while (n > 1) {
+    size_t half = n / 2;
+    base = base[half - 1] < key ? base + half : base;
+    n -= half;
+  }
+  return (base - keys) + (*base < key);
+}
+
+template <typename K, typename V>
+size_t MappedTreemap<K, V>::UpperBound(const K& key) const {
+  if (!count)
+    return 0;
+  const K *base = keys;
+  size_t n = count;
+  while (n > 1) {
+    size_t half = n / 2;
+    base = key < base[half - 1] ? base : base + half;
+    n -= half;
+  }
+  return (base - keys) + !(key < *base);
+}
+
+#endif  // MAPPED_TREEMAP_H_
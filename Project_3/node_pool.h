@@ -0,0 +1,100 @@
+#ifndef NODE_POOL_H_
+#define NODE_POOL_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Allocator for node-based containers that hands out one T at a time from
+// a pool, for use as Treemap's Alloc template parameter.
+//
+// Slots come from geometrically growing chunks, so N nodes take O(log N)
+// trips to the system allocator and nodes allocated together (e.g. by a
+// bulk load) are contiguous. Released slots go on a free list and are
+// reused most recently freed first, while they are still in cache. Memory
+// is only returned to the system when the pool is destroyed.
+template <typename T>
+class NodePool {
+ public:
+  typedef T value_type;
+
+  // Constructors/Destructor
+  NodePool() {}
+  // Copies (including rebound ones) start with an empty pool of their own
+  NodePool(const NodePool&) {}
+  template <typename U>
+  explicit NodePool(const NodePool<U>&) {}
+  NodePool& operator=(const NodePool&) = delete;
+
+  // * Allocation
+  // Return storage for @n objects; single objects come from the pool
+  T *allocate(size_t n);
+  // Release storage returned by allocate(@n)
+  void deallocate(T *p, size_t n);
+
+  // * Statistics
+  // Return number of slots owned by the pool, live or free --O(1)
+  size_t Capacity() {
+    return capacity;
+  }
+  // Return number of chunks requested from the system allocator --O(1)
+  size_t Chunks() {
+    return chunks.size();
+  }
+
+ private:
+  // A free slot holds the link to the next free slot
+  struct FreeSlot {
+    FreeSlot *next;
+  };
+  typedef typename std::aligned_storage<
+      (sizeof(T) > sizeof(FreeSlot) ? sizeof(T) : sizeof(FreeSlot)),
+      (alignof(T) > alignof(FreeSlot) ? alignof(T) : alignof(FreeSlot))
+      >::type Slot;
+
+  // Private constants
+  static const size_t kMinChunkSize = 32;
+
+  // Private member variables
+  std::vector<std::unique_ptr<Slot[]>> chunks;
+  size_t capacity = 0;
+  FreeSlot *free_head = nullptr;
+  // Untouched remainder of the newest chunk
+  Slot *bump_next = nullptr;
+  Slot *bump_end = nullptr;
+};
+
+template <typename T>
+T *NodePool<T>::allocate(size_t n) {
+  if (n != 1)
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  if (free_head) {
+    void *slot = free_head;
+    free_head = free_head->next;
+    return static_cast<T*>(slot);
+  }
+  if (bump_next == bump_end) {
+    // Double the pool each time it fills up
+    size_t chunk_size = capacity;
+    if (chunk_size < kMinChunkSize)
+      chunk_size = kMinChunkSize;
+    chunks.push_back(std::unique_ptr<Slot[]>(new Slot[chunk_size]));
+    capacity += chunk_size;
+    bump_next = chunks.back().get();
+    bump_end = bump_next + chunk_size;
+  }
+  return reinterpret_cast<T*>(bump_next++);
+}
+
+template <typename T>
+void NodePool<T>::deallocate(T *p, size_t n) {
+  if (n != 1) {
+    ::operator delete(p);
+    return;
+  }
+  free_head = new (static_cast<void*>(p)) FreeSlot{ free_head };
+}
+
+#endif  // NODE_POOL_H_
@@ -0,0 +1,226 @@
+#ifndef PATH_COPY_TREE_H_
+#define PATH_COPY_TREE_H_
+
+#include <algorithm>
+#include <cstddef>
+
+// AVL tree operations by path copying, shared by PersistentTreemap and
+// ConcurrentTreemap.
+//
+// Nodes are immutable: an update builds new copies of the O(log N) nodes
+// on the path it changes, sharing every other subtree with the previous
+// version, and returns the new root. Children are held by Ptr<const
+// Node>, which is either a std::shared_ptr (nodes are freed with the last
+// version using them) or a raw pointer (the owner frees them).
+//
+// Updates take a @nodes policy, which must provide
+//   NodePtr Make(key, value, left, right)  allocates a new node
+//   void Retire(const NodePtr& n)          n is replaced by the new version
+// Every node of the old version that the new one no longer uses is
+// retired exactly once.
+template <typename K, typename V, template <typename> class Ptr>
+struct PathCopyTree {
+  struct Node;
+  typedef Ptr<const Node> NodePtr;
+  struct Node {
+    Node(const K& key, const V& value, const NodePtr& left,
+        const NodePtr& right)
+        : key(key), value(value), left(left), right(right),
+          height(1 + std::max(HeightOf(left), HeightOf(right))),
+          size(1 + SizeOf(left) + SizeOf(right)) {}
+    K key;
+    V value;
+    NodePtr left;
+    NodePtr right;
+    int height;
+    size_t size;
+  };
+
+  static int HeightOf(const NodePtr& n) {
+    return n ? n->height : 0;
+  }
+  static size_t SizeOf(const NodePtr& n) {
+    return n ? n->size : 0;
+  }
+  // Return the node @n points to, nullptr if none
+  static const Node *Get(const NodePtr& n) {
+    return n ? &*n : nullptr;
+  }
+
+  // * Lookup, in the version rooted at @n --O(log N)
+  // Return node holding @key, nullptr if none
+  static const Node *FindNode(const Node *n, const K& key);
+  // Return node with the greatest key <= @key, nullptr if none
+  static const Node *FloorNode(const Node *n, const K& key);
+  // Return node with the least key >= @key, nullptr if none
+  static const Node *CeilNode(const Node *n, const K& key);
+  // Calls @callback(key, value) on every entry with @lo <= key <= @hi in
+  // increasing key order --O(log N + number of entries visited)
+  template <typename F>
+  static void RangeOf(const Node *n, const K& lo, const K& hi, F& callback);
+
+  // * Updates, returning the root of the new version --O(log N)
+  // Return a balanced node (key, value, left, right), whose subtrees
+  // differ in height by at most two
+  template <typename M>
+  static NodePtr Balance(M& nodes, const K& key, const V& value,
+      const NodePtr& left, const NodePtr& right);
+  // @key must not be in @n
+  template <typename M>
+  static NodePtr InsertAt(M& nodes, const NodePtr& n, const K& key,
+      const V& value);
+  // @key must be in @n
+  template <typename M>
+  static NodePtr RemoveAt(M& nodes, const NodePtr& n, const K& key);
+  // Removes the min node of @n into @min
+  template <typename M>
+  static NodePtr RemoveMin(M& nodes, const NodePtr& n, NodePtr *min);
+};
+
+template <typename K, typename V, template <typename> class Ptr>
+const typename PathCopyTree<K, V, Ptr>::Node *
+PathCopyTree<K, V, Ptr>::FindNode(const Node *n, const K& key) {
+  while (n) {
+    if (key < n->key)
+      n = Get(n->left);
+    else if (n->key < key)
+      n = Get(n->right);
+    else
+      return n;
+  }
+  return nullptr;
+}
+
+template <typename K, typename V, template <typename> class Ptr>
+const typename PathCopyTree<K, V, Ptr>::Node *
+PathCopyTree<K, V, Ptr>::FloorNode(const Node *n, const K& key) {
+  const Node *floor = nullptr;
+  while (n) {
+    if (key < n->key) {
+      n = Get(n->left);
+    } else {
+      floor = n;
+      n = Get(n->right);
+    }
+  }
+  return floor;
+}
+
+template <typename K, typename V, template <typename> class Ptr>
+const typename PathCopyTree<K, V, Ptr>::Node *
+PathCopyTree<K, V, Ptr>::CeilNode(const Node *n, const K& key) {
+  const Node *ceil = nullptr;
+  while (n) {
+    if (n->key < key) {
+      n = Get(n->right);
+    } else {
+      ceil = n;
+      n = Get(n->left);
+    }
+  }
+  return ceil;
+}
+
+template <typename K, typename V, template <typename> class Ptr>
+template <typename F>
+void PathCopyTree<K, V, Ptr>::RangeOf(const Node *n, const K& lo,
+    const K& hi, F& callback) {
+  // Recursion depth is bounded by the height of the tree
+  if (!n)
+    return;
+  if (lo < n->key)
+    RangeOf(Get(n->left), lo, hi, callback);
+  if (!(n->key < lo) && !(hi < n->key))
+    callback(n->key, n->value);
+  if (n->key < hi)
+    RangeOf(Get(n->right), lo, hi, callback);
+}
+
+template <typename K, typename V, template <typename> class Ptr>
+template <typename M>
+typename PathCopyTree<K, V, Ptr>::NodePtr PathCopyTree<K, V, Ptr>::Balance(
+    M& nodes, const K& key, const V& value, const NodePtr& left,
+    const NodePtr& right) {
+  // Same rotations as Treemap, except that the nodes whose children
+  // change are copied instead of relinked
+  if (HeightOf(left) > HeightOf(right) + 1) {
+    if (HeightOf(left->left) >= HeightOf(left->right)) {
+      nodes.Retire(left);
+      return nodes.Make(left->key, left->value, left->left,
+          nodes.Make(key, value, left->right, right));
+    }
+    const NodePtr& mid = left->right;
+    nodes.Retire(left);
+    nodes.Retire(mid);
+    return nodes.Make(mid->key, mid->value,
+        nodes.Make(left->key, left->value, left->left, mid->left),
+        nodes.Make(key, value, mid->right, right));
+  }
+  if (HeightOf(right) > HeightOf(left) + 1) {
+    if (HeightOf(right->right) >= HeightOf(right->left)) {
+      nodes.Retire(right);
+      return nodes.Make(right->key, right->value,
+          nodes.Make(key, value, left, right->left), right->right);
+    }
+    const NodePtr& mid = right->left;
+    nodes.Retire(right);
+    nodes.Retire(mid);
+    return nodes.Make(mid->key, mid->value,
+        nodes.Make(key, value, left, mid->left),
+        nodes.Make(right->key, right->value, mid->right, right->right));
+  }
+  return nodes.Make(key, value, left, right);
+}
+
+template <typename K, typename V, template <typename> class Ptr>
+template <typename M>
+typename PathCopyTree<K, V, Ptr>::NodePtr PathCopyTree<K, V, Ptr>::InsertAt(
+    M& nodes, const NodePtr& n, const K& key, const V& value) {
+  if (!n)
+    return nodes.Make(key, value, nullptr, nullptr);
+  nodes.Retire(n);
+  if (key < n->key)
+    return Balance(nodes, n->key, n->value,
+        InsertAt(nodes, n->left, key, value), n->right);
+  return Balance(nodes, n->key, n->value, n->left,
+      InsertAt(nodes, n->right, key, value));
+}
+
+template <typename K, typename V, template <typename> class Ptr>
+template <typename M>
+typename PathCopyTree<K, V, Ptr>::NodePtr PathCopyTree<K, V, Ptr>::RemoveAt(
+    M& nodes, const NodePtr& n, const K& key) {
+  nodes.Retire(n);
+  if (key < n->key)
+    return Balance(nodes, n->key, n->value, RemoveAt(nodes, n->left, key),
+        n->right);
+  if (n->key < key)
+    return Balance(nodes, n->key, n->value, n->left,
+        RemoveAt(nodes, n->right, key));
+  // Found: the successor (if any) takes its place
+  if (!n->left || !n->right)
+    return n->left ? n->left : n->right;
+  NodePtr min;
+  NodePtr right = RemoveMin(nodes, n->right, &min);
+  return Balance(nodes, min->key, min->value, n->left, right);
+}
+
+template <typename K, typename V, template <typename> class Ptr>
+template <typename M>
+typename PathCopyTree<K, V, Ptr>::NodePtr
+PathCopyTree<K, V, Ptr>::RemoveMin(M& nodes, const NodePtr& n,
+    NodePtr *min) {
+  nodes.Retire(n);
+  if (!n->left) {
+    *min = n;
+    return n->right;
+  }
+  return Balance(nodes, n->key, n->value, RemoveMin(nodes, n->left, min),
+      n->right);
+}
+
+// Ptr for nodes whose owner frees them
+template <typename T>
+using RawPtr = T*;
+
+#endif  // PATH_COPY_TREE_H_
@@ -0,0 +1,181 @@
+#ifndef PERSISTENT_TREEMAP_H_
+#define PERSISTENT_TREEMAP_H_
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include "path_copy_tree.h"
+
+// Ordered map with O(1) snapshots.
+//
+// Nodes are immutable and reference counted: an update copies the
+// O(log N) nodes on the path it changes and shares every other subtree
+// with the previous version, so a snapshot is just another reference to
+// the current root and stays frozen while the map it was taken from
+// keeps changing. A node is freed when the last version using it goes.
+//
+// Versions never modify shared nodes, so a snapshot may be read from one
+// thread while another thread updates the map it came from (each
+// PersistentTreemap object itself must only be used by one thread at a
+// time).
+template <typename K, typename V>
+class PersistentTreemap {
+ public:
+  // Constructor
+  PersistentTreemap() = default;
+  // Copies are snapshots --O(1)
+  PersistentTreemap(const PersistentTreemap&) = default;
+  PersistentTreemap& operator=(const PersistentTreemap&) = default;
+
+  // Return a frozen copy of the current version --O(1)
+  PersistentTreemap Snapshot() const;
+
+  // * Capacity
+  // Returns number of key-value mappings in map --O(1)
+  size_t Size() const;
+  // Returns true if map is empty --O(1)
+  bool Empty() const;
+
+  // * Modifiers
+  // Inserts @key in map --O(log N)
+  // Throws exception if key already exists
+  void Insert(const K& key, const V& value);
+  // Remove @key from map --O(log N)
+  // Throws exception if key doesn't exists
+  void Remove(const K& key);
+
+  // * Lookup
+  // Return value corresponding to @key --O(log N)
+  // Throws exception if tree is empty or key doesn't exists
+  const V& Get(const K& key) const;
+  // Return greatest key less than or equal to @key --O(log N)
+  // Throws exception if tree is empty or no floor exists for key
+  const K& FloorKey(const K& key) const;
+  // Return least key greater than or equal to @key --O(log N)
+  // Throws exception if tree is empty or no ceil exists for key
+  const K& CeilKey(const K& key) const;
+  // Return whether @key is found in map --O(log N)
+  bool ContainsKey(const K& key) const;
+  // Return max/min key in map --O(log N)
+  // Throws exception if tree is empty
+  const K& MaxKey() const;
+  const K& MinKey() const;
+
+  // Call @callback(key, value) on every entry with @lo <= key <= @hi in
+  // increasing key order --O(log N + number of entries visited)
+  template <typename F>
+  void Range(const K& lo, const K& hi, F callback) const;
+
+ private:
+  // Private types
+  typedef PathCopyTree<K, V, std::shared_ptr> Tree;
+  typedef typename Tree::Node Node;
+  typedef typename Tree::NodePtr NodePtr;
+  // Nodes are freed by their reference counts, so the ones replaced by
+  // an update need no bookkeeping
+  struct Nodes {
+    static NodePtr Make(const K& key, const V& value, const NodePtr& left,
+        const NodePtr& right) {
+      return std::make_shared<const Node>(key, value, left, right);
+    }
+    static void Retire(const NodePtr&) {}
+  };
+
+  // Private member variables
+  NodePtr root;
+};
+
+template <typename K, typename V>
+PersistentTreemap<K, V> PersistentTreemap<K, V>::Snapshot() const {
+  return *this;
+}
+
+template <typename K, typename V>
+size_t PersistentTreemap<K, V>::Size() const {
+  return Tree::SizeOf(root);
+}
+
+template <typename K, typename V>
+bool PersistentTreemap<K, V>::Empty() const {
+  return !root;
+}
+
+template <typename K, typename V>
+void PersistentTreemap<K, V>::Insert(const K& key, const V& value) {
+  if (Tree::FindNode(root.get(), key))
+    throw std::invalid_argument("Duplicate Key");
+  Nodes nodes;
+  root = Tree::InsertAt(nodes, root, key, value);
+}
+
+template <typename K, typename V>
+void PersistentTreemap<K, V>::Remove(const K& key) {
+  if (!Tree::FindNode(root.get(), key))
+    throw std::invalid_argument("Invalid  key");
+  Nodes nodes;
+  root = Tree::RemoveAt(nodes, root, key);
+}
+
+template <typename K, typename V>
+const V& PersistentTreemap<K, V>::Get(const K& key) const {
+  if (!root)
+    throw std::underflow_error("Empty tree");
+  const Node *n = Tree::FindNode(root.get(), key);
+  if (!n)
+    throw std::invalid_argument("Invalid  key");
+  return n->value;
+}
+
+template <typename K, typename V>
+const K& PersistentTreemap<K, V>::FloorKey(const K& key) const {
+  if (!root)
+    throw std::underflow_error("Empty tree");
+  const Node *floor = Tree::FloorNode(root.get(), key);
+  if (!floor)
+    throw std::out_of_range("Out of range!");
+  return floor->key;
+}
+
+template <typename K, typename V>
+const K& PersistentTreemap<K, V>::CeilKey(const K& key) const {
+  if (!root)
+    throw std::underflow_error("Empty tree");
+  const Node *ceil = Tree::CeilNode(root.get(), key);
+  if (!ceil)
+    throw std::out_of_range("Out of range!");
+  return ceil->key;
+}
+
+template <typename K, typename V>
+bool PersistentTreemap<K, V>::ContainsKey(const K& key) const {
+  return Tree::FindNode(root.get(), key) != nullptr;
+}
+
+template <typename K, typename V>
+const K& PersistentTreemap<K, V>::MaxKey() const {
+  if (!root)
+    throw std::underflow_error("Empty tree");
+  const Node *n = root.get();
+  while (n->right)
+    n = n->right.get();
+  return n->key;
+}
+
+template <typename K, typename V>
+const K& PersistentTreemap<K, V>::MinKey() const {
+  if (!root)
+    throw std::underflow_error("Empty tree");
+  const Node *n = root.get();
+  while (n->left)
+    n = n->left.get();
+  return n->key;
+}
+
+template <typename K, typename V>
+template <typename F>
+void PersistentTreemap<K, V>::Range(const K& lo, const K& hi,
+    F callback) const {
+  Tree::RangeOf(root.get(), lo, hi, callback);
+}
+
+#endif  // PERSISTENT_TREEMAP_H_
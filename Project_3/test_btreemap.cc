@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+
+#include "btreemap.h"
+
+TEST(BTreemap, Empty) {
+  BTreemap<int, int> map;
+
+  /* Should be fully empty */
+  EXPECT_EQ(map.Empty(), true);
+  EXPECT_EQ(map.Size(), 0);
+  EXPECT_EQ(map.Height(), 0);
+  EXPECT_EQ(map.ContainsKey(42), false);
+  EXPECT_EQ(map.ContainsValue(42), false);
+  EXPECT_THROW(map.Get(42), std::exception);
+  EXPECT_THROW(map.FloorKey(42), std::exception);
+  EXPECT_THROW(map.CeilKey(42), std::exception);
+  EXPECT_THROW(map.MinKey(), std::exception);
+  EXPECT_THROW(map.MaxKey(), std::exception);
+  EXPECT_THROW(map.Remove(42), std::exception);
+}
+
+TEST(BTreemap, SmallTree) {
+  BTreemap<int, char> map;
+
+  /* Same checks as the Treemap MegaTree test */
+  map.Insert(23, 'A');
+  map.Insert(42, 'B');
+  map.Insert(5, 'C');
+  map.Insert(8, 'D');
+  map.Insert(2, 'E');
+  map.Insert(59, 'F');
+  map.Insert(73, 'G');
+  map.Insert(67, 'H');
+  EXPECT_EQ(map.Size(), 8);
+  EXPECT_EQ(map.MinKey(), 2);
+  EXPECT_EQ(map.MaxKey(), 73);
+  EXPECT_EQ(map.Get(23), 'A');
+  EXPECT_EQ(map.FloorKey(8), 8);
+  EXPECT_EQ(map.FloorKey(7), 5);
+  EXPECT_EQ(map.CeilKey(23), 23);
+  EXPECT_EQ(map.CeilKey(43), 59);
+  EXPECT_EQ(map.ContainsValue('H'), true);
+  EXPECT_EQ(map.ContainsValue('Z'), false);
+  EXPECT_THROW(map.FloorKey(1), std::exception);
+  EXPECT_THROW(map.CeilKey(74), std::exception);
+  EXPECT_THROW(map.Insert(23, 'A'), std::exception);
+}
+
+TEST(BTreemap, SortedInsertRemove) {
+  BTreemap<int, std::string> map;
+
+  /* Many keys span several levels and leaves */
+  const int n = 100000;
+  for (int i = 0; i < n; i++)
+    map.Insert(2 * i, std::to_string(i));
+  EXPECT_EQ(map.Size(), n);
+  EXPECT_LE(map.Height(), 4);
+  EXPECT_EQ(map.Get(1000), "500");
+  EXPECT_EQ(map.FloorKey(1001), 1000);
+  EXPECT_EQ(map.CeilKey(1001), 1002);
+  for (int i = 0; i < n; i++)
+    map.Remove(2 * i);
+  EXPECT_EQ(map.Empty(), true);
+  EXPECT_EQ(map.Height(), 0);
+}
+
+TEST(BTreemap, RandomAgainstStdMap) {
+  BTreemap<int, int> map;
+  std::map<int, int> ref;
+
+  /* Random inserts and removes agree with std::map, including floor
+     and ceil lookups that cross leaf boundaries */
+  unsigned seed = 12345;
+  for (int i = 0; i < 200000; i++) {
+    seed = seed * 1103515245 + 12345;
+    int key = (seed >> 8) % 5000;
+    if (ref.count(key)) {
+      map.Remove(key);
+      ref.erase(key);
+    } else {
+      map.Insert(key, i);
+      ref[key] = i;
+    }
+    if (i % 97 == 0 && !ref.empty()) {
+      auto ceil = ref.lower_bound(key + 1);
+      if (ceil != ref.end())
+        EXPECT_EQ(map.CeilKey(key + 1), ceil->first);
+      else
+        EXPECT_THROW(map.CeilKey(key + 1), std::exception);
+      auto floor = ref.upper_bound(key - 1);
+      if (floor != ref.begin())
+        EXPECT_EQ(map.FloorKey(key - 1), std::prev(floor)->first);
+      else
+        EXPECT_THROW(map.FloorKey(key - 1), std::exception);
+    }
+  }
+  EXPECT_EQ(map.Size(), ref.size());
+  for (auto& kv : ref)
+    EXPECT_EQ(map.Get(kv.first), kv.second);
+  EXPECT_EQ(map.MinKey(), ref.begin()->first);
+  EXPECT_EQ(map.MaxKey(), ref.rbegin()->first);
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,293 @@
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "change_log.h"
+#include "treemultimap.h"
+
+static const char kPath[] = "test_change_log.log";
+static const char kBase[] = "test_change_log.store";
+
+// Applies a replayed change to @map
+static void Apply(TreeMultimap<int, std::string>& map, Change change,
+    int key, const std::string& value) {
+  if (change == Change::kInsert)
+    map.Insert(key, value);
+  else
+    map.Remove(key, value);
+}
+
+// Return every (key, value) pair of @map in order
+static std::vector<std::pair<int, std::string>> Entries(
+    TreeMultimap<int, std::string>& map) {
+  std::vector<std::pair<int, std::string>> entries;
+  for (auto& run : map) {
+    for (auto& value : run.second)
+      entries.emplace_back(run.first, value);
+  }
+  return entries;
+}
+
+// Loads the store at kBase into @map, returning the number of changes
+// replayed
+static size_t Recover(TreeMultimap<int, std::string>& map) {
+  ChangeLogStore<int, std::string> store(kBase);
+  map.BuildFromSorted(store.Snapshot());
+  return store.Replay([&](Change change, int key, const std::string& value) {
+    Apply(map, change, key, value);
+  });
+}
+
+// Removes the files of the store at kBase, up to generation @last
+static void RemoveStore(uint64_t last) {
+  std::string base = kBase;
+  std::remove(base.c_str());
+  for (uint64_t g = 0; g <= last; g++) {
+    std::remove((base + "." + std::to_string(g) + ".snap").c_str());
+    std::remove((base + "." + std::to_string(g) + ".log").c_str());
+  }
+}
+
+TEST(ChangeLog, AppendAndReplay) {
+  std::remove(kPath);
+  {
+    ChangeLog<int, std::string> log(kPath);
+    log.Insert(5, "Alice");
+    log.Insert(5, "Bob");
+    log.Insert(-3, "");
+    log.Remove(5, "Alice");
+    EXPECT_EQ(log.Size(), 4);
+    log.Flush();
+  }
+  TreeMultimap<int, std::string> map;
+  auto apply = [&](Change change, int key, const std::string& value) {
+    Apply(map, change, key, value);
+  };
+  EXPECT_EQ((ChangeLog<int, std::string>::Replay(kPath, apply)), 4);
+  std::vector<std::pair<int, std::string>> expected = {{-3, ""}, {5, "Bob"}};
+  EXPECT_EQ(Entries(map), expected);
+
+  /* Reopening appends after the existing records */
+  {
+    ChangeLog<int, std::string> log(kPath);
+    EXPECT_EQ(log.Size(), 4);
+    log.Insert(7, "Carol");
+    log.Sync();
+  }
+  map.Clear();
+  EXPECT_EQ((ChangeLog<int, std::string>::Replay(kPath, apply)), 5);
+  EXPECT_EQ(map.Get(7), "Carol");
+
+  /* Logs of another key type are rejected */
+  EXPECT_THROW((ChangeLog<long long, std::string>(kPath)), std::exception);
+  std::remove(kPath);
+  EXPECT_EQ((ChangeLog<int, std::string>::Replay(kPath, apply)), 0);
+}
+
+TEST(ChangeLog, TornRecord) {
+  std::remove(kPath);
+  {
+    ChangeLog<int, double> log(kPath);
+    for (int i = 0; i < 10; i++)
+      log.Insert(i, i * 0.5);
+  }
+  size_t valid_bytes = 0;
+  auto ignore = [](Change, int, double) {};
+  ChangeLog<int, double>::Replay(kPath, ignore, &valid_bytes);
+
+  /* A crash in the middle of the last record */
+  ASSERT_EQ(truncate(kPath, valid_bytes - 3), 0);
+  EXPECT_EQ((ChangeLog<int, double>::Replay(kPath, ignore)), 9);
+
+  /* Reopening cuts it off, so that new records can be read back */
+  {
+    ChangeLog<int, double> log(kPath);
+    EXPECT_EQ(log.Size(), 9);
+    log.Insert(42, 1.5);
+  }
+  std::vector<int> keys;
+  ChangeLog<int, double>::Replay(kPath, [&](Change, int key, double) {
+    keys.push_back(key);
+  });
+  ASSERT_EQ(keys.size(), 10);
+  EXPECT_EQ(keys.back(), 42);
+
+  /* A corrupted record ends the log */
+  {
+    std::fstream file(kPath, std::ios::in | std::ios::out |
+        std::ios::binary);
+    file.seekp(valid_bytes / 2);
+    file.put('\x7f');
+  }
+  EXPECT_LT((ChangeLog<int, double>::Replay(kPath, ignore)), 10);
+  std::remove(kPath);
+}
+
+TEST(ChangeLog, FailedFlush) {
+  std::remove(kPath);
+  ChangeLog<int, std::string> log(kPath);
+  log.Sync();
+  /* The file may only grow a little: the flush writes part of the records
+     and then fails */
+  struct rlimit limit, small;
+  ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &limit), 0);
+  small = limit;
+  small.rlim_cur = sizeof(ChangeLogHeader) + 100;
+  signal(SIGXFSZ, SIG_IGN);
+  ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &small), 0);
+  for (int i = 0; i < 20; i++)
+    log.Insert(i, "donor");
+  EXPECT_THROW(log.Flush(), std::exception);
+  ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limit), 0);
+  signal(SIGXFSZ, SIG_DFL);
+
+  /* Retrying writes the rest, and only the rest */
+  log.Flush();
+  std::vector<int> keys;
+  ChangeLog<int, std::string>::Replay(kPath,
+      [&](Change, int key, const std::string&) {
+    keys.push_back(key);
+  });
+  ASSERT_EQ(keys.size(), 20);
+  for (int i = 0; i < 20; i++)
+    EXPECT_EQ(keys[i], i);
+  std::remove(kPath);
+}
+
+TEST(ChangeLog, UnknownChange) {
+  std::remove(kPath);
+  size_t first_end = 0, valid_bytes = 0;
+  auto ignore = [](Change, int, double) {};
+  {
+    ChangeLog<int, double> log(kPath);
+    log.Insert(1, 0.5);
+    log.Flush();
+    ChangeLog<int, double>::Replay(kPath, ignore, &first_end);
+    log.Remove(1, 0.5);
+    log.Insert(2, 1.5);
+  }
+  ChangeLog<int, double>::Replay(kPath, ignore, &valid_bytes);
+
+  /* A record of an unknown change, with a matching checksum, ends the log
+     like a corrupted one */
+  std::string log_bytes;
+  {
+    std::ifstream file(kPath, std::ios::binary);
+    log_bytes.assign(std::istreambuf_iterator<char>(file),
+        std::istreambuf_iterator<char>());
+  }
+  uint32_t record_size;
+  std::memcpy(&record_size, &log_bytes[first_end], sizeof(record_size));
+  log_bytes[first_end + 8] = 3;
+  uint32_t checksum = ChangeChecksum(&log_bytes[first_end + 8], record_size);
+  std::memcpy(&log_bytes[first_end + 4], &checksum, sizeof(checksum));
+  std::ofstream(kPath, std::ios::binary) << log_bytes;
+  std::vector<Change> changes;
+  EXPECT_EQ((ChangeLog<int, double>::Replay(kPath,
+      [&](Change change, int, double) {
+    changes.push_back(change);
+  }, &valid_bytes)), 1);
+  EXPECT_EQ(changes, std::vector<Change>({Change::kInsert}));
+  EXPECT_EQ(valid_bytes, first_end);
+  std::remove(kPath);
+}
+
+TEST(ChangeLogStore, CompactAndRecover) {
+  RemoveStore(10);
+  TreeMultimap<int, std::string> map;
+  EXPECT_EQ(Recover(map), 0);
+  EXPECT_EQ(map.Size(), 0);
+  {
+    ChangeLogStore<int, std::string> store(kBase);
+    EXPECT_EQ(store.Generation(), 0);
+    for (int i = 0; i < 100; i++) {
+      map.Insert(i % 7, "donor" + std::to_string(i));
+      store.Insert(i % 7, "donor" + std::to_string(i));
+    }
+    store.Compact(Entries(map));
+    /* Changes go on while the snapshot is written */
+    for (int i = 0; i < 10; i++) {
+      map.Remove(i % 7, "donor" + std::to_string(i));
+      store.Remove(i % 7, "donor" + std::to_string(i));
+    }
+    map.Insert(3, "Alice");
+    store.Insert(3, "Alice");
+    EXPECT_EQ(store.LogSize(), 11);
+    store.Wait();
+    EXPECT_EQ(store.Generation(), 1);
+    store.Compact(Entries(map));
+    store.Insert(-1, "Bob");
+    map.Insert(-1, "Bob");
+  }
+
+  /* Only the files of the latest generation are left */
+  std::string base = kBase;
+  EXPECT_EQ(FileExists(base + ".2.snap"), true);
+  EXPECT_EQ(FileExists(base + ".2.log"), true);
+  EXPECT_EQ(FileExists(base + ".1.snap"), false);
+  EXPECT_EQ(FileExists(base + ".1.log"), false);
+  EXPECT_EQ(FileExists(base + ".0.log"), false);
+
+  TreeMultimap<int, std::string> recovered;
+  EXPECT_EQ(Recover(recovered), 1);
+  EXPECT_EQ(Entries(recovered), Entries(map));
+  RemoveStore(10);
+}
+
+TEST(ChangeLogStore, UnfinishedCompaction) {
+  RemoveStore(10);
+  /* A crash before snapshot 1 was committed leaves both logs */
+  std::string base = kBase;
+  {
+    ChangeLog<int, std::string> log(base + ".0.log");
+    log.Insert(1, "Alice");
+    log.Insert(2, "Bob");
+  }
+  {
+    ChangeLog<int, std::string> log(base + ".1.log");
+    log.Remove(1, "Alice");
+    log.Insert(3, "Carol");
+  }
+  {
+    std::ofstream partial(base + ".1.snap.tmp");
+    partial << "partial";
+  }
+
+  TreeMultimap<int, std::string> map;
+  EXPECT_EQ(Recover(map), 4);
+  std::vector<std::pair<int, std::string>> expected = {
+    {2, "Bob"}, {3, "Carol"}
+  };
+  EXPECT_EQ(Entries(map), expected);
+  EXPECT_EQ(FileExists(base + ".1.snap.tmp"), false);
+
+  /* Changes are appended to the last log, and the next compaction
+     covers both */
+  {
+    ChangeLogStore<int, std::string> store(kBase);
+    store.Insert(4, "Dan");
+    map.Insert(4, "Dan");
+    store.Compact(Entries(map));
+    store.Wait();
+    EXPECT_EQ(store.Generation(), 2);
+  }
+  EXPECT_EQ(FileExists(base + ".0.log"), false);
+  EXPECT_EQ(FileExists(base + ".1.log"), false);
+  TreeMultimap<int, std::string> recovered;
+  EXPECT_EQ(Recover(recovered), 0);
+  EXPECT_EQ(Entries(recovered), Entries(map));
+  RemoveStore(10);
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "concurrent_treemap.h"
+
+TEST(ConcurrentTreemap, Empty) {
+  ConcurrentTreemap<int, int> map;
+
+  /* Should be fully empty */
+  EXPECT_EQ(map.Empty(), true);
+  EXPECT_EQ(map.Size(), 0);
+  EXPECT_THROW(map.Get(42), std::exception);
+  EXPECT_THROW(map.MinKey(), std::exception);
+  EXPECT_THROW(map.Remove(42), std::exception);
+}
+
+TEST(ConcurrentTreemap, Lookup) {
+  ConcurrentTreemap<int, char> map;
+
+  map.Insert(23, 'A');
+  map.Insert(42, 'B');
+  map.Insert(5, 'C');
+  EXPECT_THROW(map.Insert(23, 'D'), std::exception);
+  EXPECT_EQ(map.Size(), 3);
+  EXPECT_EQ(map.Get(42), 'B');
+  EXPECT_EQ(map.FloorKey(30), 23);
+  EXPECT_EQ(map.CeilKey(30), 42);
+  EXPECT_THROW(map.FloorKey(1), std::exception);
+  EXPECT_THROW(map.CeilKey(50), std::exception);
+  EXPECT_EQ(map.MinKey(), 5);
+  EXPECT_EQ(map.MaxKey(), 42);
+  EXPECT_EQ(map.ContainsKey(5), true);
+  map.Remove(5);
+  EXPECT_EQ(map.ContainsKey(5), false);
+}
+
+TEST(ConcurrentTreemap, RandomAgainstStdMap) {
+  ConcurrentTreemap<int, int> map;
+  std::map<int, int> ref;
+
+  /* Random inserts and removes agree with std::map */
+  unsigned seed = 12345;
+  for (int i = 0; i < 20000; i++) {
+    seed = seed * 1103515245 + 12345;
+    int key = (seed >> 8) % 2000;
+    if (ref.count(key)) {
+      map.Remove(key);
+      ref.erase(key);
+    } else {
+      map.Insert(key, i);
+      ref[key] = i;
+    }
+  }
+  EXPECT_EQ(map.Size(), ref.size());
+  std::vector<std::pair<int, int>> entries;
+  map.Range(-1, 2000, [&entries](int key, int value) {
+    entries.push_back(std::make_pair(key, value));
+  });
+  std::vector<std::pair<int, int>> expected(ref.begin(), ref.end());
+  EXPECT_EQ(entries, expected);
+}
+
+TEST(ConcurrentTreemap, ReadersSeeConsistentVersions) {
+  ConcurrentTreemap<int, int> map;
+  std::atomic<bool> done(false);
+  std::atomic<int> errors(0);
+  const int kKeys = 5000;
+
+  /* Readers run while a writer inserts every key, then removes the even
+     ones; every version they see is a sorted map from key to 2 * key */
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; r++) {
+    readers.push_back(std::thread([&map, &done, &errors, r]() {
+      unsigned seed = r;
+      while (!done.load()) {
+        seed = seed * 1103515245 + 12345;
+        int key = (seed >> 8) % kKeys;
+        try {
+          if (map.Get(key) != 2 * key)
+            errors++;
+        } catch (std::exception&) {
+        }
+        size_t count = 0;
+        int last = -1;
+        map.Range(key, key + 100, [&](int k, int v) {
+          if (k <= last || v != 2 * k)
+            errors++;
+          last = k;
+          count++;
+        });
+        if (count > 101)
+          errors++;
+      }
+    }));
+  }
+  for (int i = 0; i < kKeys; i++)
+    map.Insert(i, 2 * i);
+  for (int i = 0; i < kKeys; i += 2)
+    map.Remove(i);
+  done = true;
+  for (auto& reader : readers)
+    reader.join();
+
+  EXPECT_EQ(errors.load(), 0);
+  EXPECT_EQ(map.Size(), kKeys / 2);
+  EXPECT_EQ(map.MinKey(), 1);
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
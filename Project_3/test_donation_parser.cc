@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "donation_parser.h"
+
+// Parses all of @text
+static DonationParser ParseText(const std::string& text) {
+  DonationParser parser;
+  parser.Parse(text.data(), text.data() + text.size());
+  return parser;
+}
+
+TEST(DonationParser, Rows) {
+  DonationParser parser = ParseText("Alice,100\nBob Smith,-5\n\nCarol,7.5");
+
+  /* Empty lines are skipped, the last line needs no newline, amounts are
+     in cents */
+  ASSERT_EQ(parser.Rows().size(), 3);
+  EXPECT_EQ(parser.Name(parser.Rows()[0]), "Alice");
+  EXPECT_EQ(parser.Rows()[0].amount, 10000);
+  EXPECT_EQ(parser.Name(parser.Rows()[1]), "Bob Smith");
+  EXPECT_EQ(parser.Rows()[1].amount, -500);
+  EXPECT_EQ(parser.Name(parser.Rows()[2]), "Carol");
+  EXPECT_EQ(parser.Rows()[2].amount, 750);
+
+  /* Windows line endings, and rows appended by a second call */
+  std::string more = "Dan,42\r\n,3\r\n";
+  parser.Parse(more.data(), more.data() + more.size());
+  ASSERT_EQ(parser.Rows().size(), 5);
+  EXPECT_EQ(parser.Name(parser.Rows()[3]), "Dan");
+  EXPECT_EQ(parser.Rows()[3].amount, 4200);
+  EXPECT_EQ(parser.Name(parser.Rows()[4]), "");
+  EXPECT_EQ(ParseText("").Rows().size(), 0);
+}
+
+TEST(DonationParser, Errors) {
+  EXPECT_THROW(ParseText("Alice 100\n"), std::invalid_argument);
+  EXPECT_THROW(ParseText("Alice,\n"), std::invalid_argument);
+  EXPECT_THROW(ParseText("Alice,abc\n"), std::invalid_argument);
+  EXPECT_THROW(ParseText("Alice,1.005\n"), std::invalid_argument);
+  EXPECT_THROW(ParseText("Alice,99999999999999999999\n"), std::out_of_range);
+}
+
+// Parses all of @text as cents
+static int64_t Cents(const std::string& text) {
+  return DonationParser::ParseCents(text.data(), text.data() + text.size());
+}
+
+TEST(DonationParser, ParseCents) {
+  /* Whole amounts are read like std::stoi */
+  const char *amounts[] = {
+    "0", "17", "+17", "-17", " 8", "12abc", "2147483647", "-2147483648",
+    "007"
+  };
+  for (const char *amount : amounts)
+    EXPECT_EQ(Cents(amount), std::stoi(amount) * 100LL) << amount;
+
+  /* Up to two decimals */
+  EXPECT_EQ(Cents("12.34"), 1234);
+  EXPECT_EQ(Cents("12.3"), 1230);
+  EXPECT_EQ(Cents("12."), 1200);
+  EXPECT_EQ(Cents("-0.05"), -5);
+  EXPECT_EQ(Cents(".5"), 50);
+  EXPECT_EQ(Cents("92233720368547758.07"), INT64_MAX);
+  EXPECT_EQ(Cents("-92233720368547758.08"), INT64_MIN);
+  EXPECT_THROW(Cents("92233720368547758.08"), std::out_of_range);
+  EXPECT_THROW(Cents("1.234"), std::invalid_argument);
+  EXPECT_THROW(Cents("-"), std::invalid_argument);
+  EXPECT_THROW(Cents("."), std::invalid_argument);
+}
+
+TEST(DonationParser, SplitLines) {
+  std::string text = "Alice,1\nBob,2\nCarol,3\nDan,4\nEve,5\n";
+  const char *begin = text.data();
+  const char *end = begin + text.size();
+
+  /* Chunks cover the text, in order, and only cut after a newline */
+  for (size_t num_chunks = 1; num_chunks < 8; num_chunks++) {
+    std::vector<const char*> cuts =
+        DonationParser::SplitLines(begin, end, num_chunks);
+    ASSERT_EQ(cuts.size(), num_chunks + 1);
+    EXPECT_EQ(cuts.front(), begin);
+    EXPECT_EQ(cuts.back(), end);
+    DonationParser parser;
+    for (size_t i = 0; i < num_chunks; i++) {
+      ASSERT_LE(cuts[i], cuts[i + 1]);
+      if (cuts[i] != begin && cuts[i] != end) {
+        ASSERT_EQ(cuts[i][-1], '\n');
+      }
+      parser.Parse(cuts[i], cuts[i + 1]);
+    }
+    ASSERT_EQ(parser.Rows().size(), 5);
+    EXPECT_EQ(parser.Name(parser.Rows()[4]), "Eve");
+  }
+
+  /* One line longer than a chunk leaves later chunks empty */
+  std::string one = "A very long donor name,100";
+  std::vector<const char*> cuts = DonationParser::SplitLines(one.data(),
+      one.data() + one.size(), 4);
+  EXPECT_EQ(cuts[1], one.data() + one.size());
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
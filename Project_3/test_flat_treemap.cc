@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "flat_treemap.h"
+
+TEST(FlatTreemap, Empty) {
+  FlatTreemap<int, int> map;
+
+  /* Should be fully empty */
+  EXPECT_EQ(map.Empty(), true);
+  EXPECT_EQ(map.Size(), 0);
+  EXPECT_EQ(map.ContainsKey(42), false);
+  EXPECT_EQ(map.LowerBound(42), 0);
+  EXPECT_THROW(map.Get(42), std::exception);
+  EXPECT_THROW(map.MinKey(), std::exception);
+  EXPECT_THROW(map.FloorKey(42), std::exception);
+
+  /* Same once built from nothing */
+  std::vector<std::pair<int, int>> none;
+  map.BuildFromSorted(none);
+  EXPECT_EQ(map.Empty(), true);
+  EXPECT_EQ(map.UpperBound(42), 0);
+}
+
+TEST(FlatTreemap, Lookup) {
+  FlatTreemap<int, std::string> map;
+  std::vector<std::pair<int, std::string>> entries = {
+    {5, "C"}, {23, "A"}, {23, "D"}, {42, "B"}
+  };
+  map.BuildFromSorted(entries);
+
+  EXPECT_EQ(map.Size(), 4);
+  EXPECT_EQ(map.Get(23), "A");
+  EXPECT_EQ(map.Get(42), "B");
+  EXPECT_THROW(map.Get(24), std::exception);
+  EXPECT_EQ(map.FloorKey(30), 23);
+  EXPECT_EQ(map.CeilKey(30), 42);
+  EXPECT_THROW(map.FloorKey(1), std::exception);
+  EXPECT_THROW(map.CeilKey(50), std::exception);
+  EXPECT_EQ(map.MinKey(), 5);
+  EXPECT_EQ(map.MaxKey(), 42);
+  EXPECT_EQ(map.LowerBound(23), 1);
+  EXPECT_EQ(map.UpperBound(23), 3);
+  EXPECT_EQ(map.Key(2), 23);
+  EXPECT_EQ(map.Value(2), "D");
+
+  /* Unsorted input is rejected and leaves the map unchanged */
+  std::vector<std::pair<int, std::string>> unsorted = {{2, "X"}, {1, "Y"}};
+  EXPECT_THROW(map.BuildFromSorted(unsorted), std::exception);
+  EXPECT_EQ(map.Size(), 4);
+  map.Clear();
+  EXPECT_EQ(map.Empty(), true);
+}
+
+TEST(FlatTreemap, BoundsAgainstStdAlgorithms) {
+  /* Every size up to a few complete trees, with repeated keys */
+  for (int size = 0; size < 70; size++) {
+    std::vector<std::pair<int, int>> entries;
+    std::vector<int> keys;
+    for (int i = 0; i < size; i++) {
+      entries.push_back(std::make_pair(i / 2 * 3, i));
+      keys.push_back(i / 2 * 3);
+    }
+    FlatTreemap<int, int> map;
+    map.BuildFromSorted(entries);
+    for (int key = -2; key < size * 2 + 2; key++) {
+      size_t lower = std::lower_bound(keys.begin(), keys.end(), key) -
+          keys.begin();
+      size_t upper = std::upper_bound(keys.begin(), keys.end(), key) -
+          keys.begin();
+      ASSERT_EQ(map.LowerBound(key), lower);
+      ASSERT_EQ(map.UpperBound(key), upper);
+      ASSERT_EQ(map.ContainsKey(key), lower != upper);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
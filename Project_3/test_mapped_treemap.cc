@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mapped_treemap.h"
+
+static const char kPath[] = "test_mapped_treemap.snap";
+
+TEST(MappedTreemap, SaveAndMapTreemap) {
+  Treemap<int, std::string> map;
+  for (int i = 0; i < 1000; i++)
+    map.Insert(i * 3, "donor" + std::to_string(i));
+  SaveSnapshot(kPath, map);
+  EXPECT_EQ(IsSnapshot(kPath), true);
+
+  MappedTreemap<int, std::string> mapped(kPath);
+  EXPECT_EQ(mapped.Size(), 1000);
+  EXPECT_EQ(mapped.MinKey(), 0);
+  EXPECT_EQ(mapped.MaxKey(), 2997);
+  for (int key = -1; key < 3001; key++) {
+    ASSERT_EQ(mapped.ContainsKey(key), map.ContainsKey(key));
+    if (map.ContainsKey(key)) {
+      ASSERT_EQ(mapped.Get(key), map.Get(key));
+    }
+    if (key >= 0) {
+      ASSERT_EQ(mapped.FloorKey(key), map.FloorKey(key));
+    }
+    if (key <= 2997) {
+      ASSERT_EQ(mapped.CeilKey(key), map.CeilKey(key));
+    }
+  }
+  EXPECT_THROW(mapped.Get(1), std::exception);
+  EXPECT_THROW(mapped.FloorKey(-1), std::exception);
+  EXPECT_THROW(mapped.CeilKey(2998), std::exception);
+  std::remove(kPath);
+}
+
+TEST(MappedTreemap, DuplicateKeysAndPositions) {
+  std::vector<std::pair<int, double>> entries = {
+    {1, 0.5}, {4, 1.5}, {4, 2.5}, {4, 3.5}, {9, 4.5}
+  };
+  SaveSnapshot(kPath, entries.begin(), entries.end());
+
+  MappedTreemap<int, double> mapped(kPath);
+  EXPECT_EQ(mapped.Size(), 5);
+  EXPECT_EQ(mapped.LowerBound(4), 1);
+  EXPECT_EQ(mapped.UpperBound(4), 4);
+  EXPECT_EQ(mapped.LowerBound(0), 0);
+  EXPECT_EQ(mapped.UpperBound(9), 5);
+  EXPECT_EQ(mapped.Get(4), 1.5);
+  EXPECT_EQ(mapped.Key(3), 4);
+  EXPECT_EQ(mapped.Value(4), 4.5);
+  std::remove(kPath);
+
+  // Unsorted entries are rejected
+  std::vector<std::pair<int, double>> unsorted = {{2, 0}, {1, 0}};
+  EXPECT_THROW(SaveSnapshot(kPath, unsorted.begin(), unsorted.end()),
+      std::exception);
+}
+
+TEST(MappedTreemap, EmptyAndInvalidFiles) {
+  Treemap<int, int> map;
+  SaveSnapshot(kPath, map);
+  {
+    MappedTreemap<int, int> mapped(kPath);
+    EXPECT_EQ(mapped.Empty(), true);
+    EXPECT_EQ(mapped.ContainsKey(0), false);
+    EXPECT_THROW(mapped.MinKey(), std::exception);
+  }
+  // Wrong key type
+  EXPECT_THROW((MappedTreemap<long long, int>(kPath)), std::exception);
+
+  // Not a snapshot
+  std::ofstream(kPath) << "Alice,100" << std::endl;
+  EXPECT_EQ(IsSnapshot(kPath), false);
+  EXPECT_THROW((MappedTreemap<int, int>(kPath)), std::exception);
+  std::remove(kPath);
+  EXPECT_THROW((MappedTreemap<int, int>(kPath)), std::exception);
+}
+
+// Overwrites offsets[@i] of the snapshot at kPath, holding @count int keys
+static void CorruptOffset(size_t count, size_t i, uint64_t offset) {
+  std::fstream file(kPath, std::ios::in | std::ios::out | std::ios::binary);
+  file.seekp(sizeof(SnapshotHeader) + SnapshotPad(count * sizeof(int)) +
+      i * sizeof(uint64_t));
+  file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+}
+
+TEST(MappedTreemap, CorruptedOffsets) {
+  Treemap<int, std::string> map;
+  map.Insert(1, "Alice");
+  map.Insert(2, "Bob");
+  map.Insert(3, "Carol");
+  SaveSnapshot(kPath, map);
+  EXPECT_EQ((MappedTreemap<int, std::string>(kPath)).Get(2), "Bob");
+
+  /* Values starting past the pool, out of order or not ending with it */
+  CorruptOffset(3, 0, 1);
+  EXPECT_THROW((MappedTreemap<int, std::string>(kPath)), std::exception);
+  SaveSnapshot(kPath, map);
+  CorruptOffset(3, 2, 1);
+  EXPECT_THROW((MappedTreemap<int, std::string>(kPath)), std::exception);
+  SaveSnapshot(kPath, map);
+  CorruptOffset(3, 1, 1000);
+  EXPECT_THROW((MappedTreemap<int, std::string>(kPath)), std::exception);
+  SaveSnapshot(kPath, map);
+  CorruptOffset(3, 3, 5);
+  EXPECT_THROW((MappedTreemap<int, std::string>(kPath)), std::exception);
+  std::remove(kPath);
+}
+
+// Overwrites the 64-bit header field at @at of the snapshot at kPath
+static void CorruptHeader(size_t at, uint64_t value) {
+  std::fstream file(kPath, std::ios::in | std::ios::out | std::ios::binary);
+  file.seekp(at);
+  file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+TEST(MappedTreemap, CorruptedHeader) {
+  Treemap<int, std::string> map;
+  for (int i = 0; i < 200; i++)
+    map.Insert(i, "donor" + std::to_string(i));
+  SaveSnapshot(kPath, map);
+  uint64_t size;
+  {
+    std::ifstream file(kPath, std::ios::binary | std::ios::ate);
+    size = file.tellg();
+  }
+
+  /* A pool size that wraps the end of the pool around to the file size */
+  CorruptHeader(offsetof(SnapshotHeader, pool_size), uint64_t(0) - 1000);
+  EXPECT_THROW((MappedTreemap<int, std::string>(kPath)), std::exception);
+
+  /* Same with a count that puts the offsets past the end of the file */
+  uint64_t count = size - 1;
+  uint64_t pool_at = sizeof(SnapshotHeader) + SnapshotPad(count * sizeof(int))
+      + (count + 1) * sizeof(uint64_t);
+  CorruptHeader(offsetof(SnapshotHeader, count), count);
+  CorruptHeader(offsetof(SnapshotHeader, pool_size), size - pool_at);
+  EXPECT_THROW((MappedTreemap<int, std::string>(kPath)), std::exception);
+
+  /* And a count so large that the keys alone wrap around */
+  count = (uint64_t(0) - 1) / sizeof(int);
+  CorruptHeader(offsetof(SnapshotHeader, count), count);
+  EXPECT_THROW((MappedTreemap<int, std::string>(kPath)), std::exception);
+  std::remove(kPath);
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "persistent_treemap.h"
+
+// Return every entry of @map in key order
+template <typename K, typename V>
+static std::vector<std::pair<K, V>> Entries(
+    const PersistentTreemap<K, V>& map, const K& lo, const K& hi) {
+  std::vector<std::pair<K, V>> entries;
+  map.Range(lo, hi, [&entries](const K& key, const V& value) {
+    entries.push_back(std::make_pair(key, value));
+  });
+  return entries;
+}
+
+TEST(PersistentTreemap, Empty) {
+  PersistentTreemap<int, int> map;
+
+  /* Should be fully empty */
+  EXPECT_EQ(map.Empty(), true);
+  EXPECT_EQ(map.Size(), 0);
+  EXPECT_THROW(map.Get(42), std::exception);
+  EXPECT_THROW(map.MaxKey(), std::exception);
+  EXPECT_THROW(map.Remove(42), std::exception);
+}
+
+TEST(PersistentTreemap, Lookup) {
+  PersistentTreemap<int, std::string> map;
+
+  map.Insert(23, "A");
+  map.Insert(42, "B");
+  map.Insert(5, "C");
+  EXPECT_THROW(map.Insert(23, "D"), std::exception);
+  EXPECT_EQ(map.Size(), 3);
+  EXPECT_EQ(map.Get(42), "B");
+  EXPECT_EQ(map.FloorKey(30), 23);
+  EXPECT_EQ(map.CeilKey(30), 42);
+  EXPECT_THROW(map.FloorKey(1), std::exception);
+  EXPECT_THROW(map.CeilKey(50), std::exception);
+  EXPECT_EQ(map.MinKey(), 5);
+  EXPECT_EQ(map.MaxKey(), 42);
+  map.Remove(5);
+  EXPECT_EQ(map.ContainsKey(5), false);
+}
+
+TEST(PersistentTreemap, SnapshotsAreFrozen) {
+  PersistentTreemap<int, int> map;
+
+  for (int i = 0; i < 100; i++)
+    map.Insert(i, i);
+  PersistentTreemap<int, int> before = map.Snapshot();
+  for (int i = 0; i < 100; i += 2)
+    map.Remove(i);
+  map.Insert(1000, 1000);
+
+  /* The snapshot still has the old version, the map the new one */
+  EXPECT_EQ(before.Size(), 100);
+  EXPECT_EQ(before.ContainsKey(0), true);
+  EXPECT_EQ(before.ContainsKey(1000), false);
+  EXPECT_EQ(map.Size(), 51);
+  EXPECT_EQ(map.ContainsKey(0), false);
+  EXPECT_EQ(map.MaxKey(), 1000);
+
+  /* Snapshots can be updated too, without affecting the map */
+  before.Remove(99);
+  EXPECT_EQ(map.ContainsKey(99), true);
+}
+
+TEST(PersistentTreemap, RandomSnapshotsAgainstStdMap) {
+  PersistentTreemap<int, int> map;
+  std::map<int, int> ref;
+  std::vector<PersistentTreemap<int, int>> snapshots;
+  std::vector<std::map<int, int>> expected;
+
+  /* Random inserts and removes, with a snapshot every 1000 steps */
+  unsigned seed = 12345;
+  for (int i = 0; i < 20000; i++) {
+    seed = seed * 1103515245 + 12345;
+    int key = (seed >> 8) % 2000;
+    if (ref.count(key)) {
+      map.Remove(key);
+      ref.erase(key);
+    } else {
+      map.Insert(key, i);
+      ref[key] = i;
+    }
+    if (i % 1000 == 0) {
+      snapshots.push_back(map.Snapshot());
+      expected.push_back(ref);
+    }
+  }
+  for (size_t i = 0; i < snapshots.size(); i++) {
+    std::vector<std::pair<int, int>> entries(expected[i].begin(),
+        expected[i].end());
+    EXPECT_EQ(Entries(snapshots[i], -1, 2000), entries);
+  }
+  std::vector<std::pair<int, int>> entries(ref.begin(), ref.end());
+  EXPECT_EQ(Entries(map, -1, 2000), entries);
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
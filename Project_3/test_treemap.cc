@@ -1,5 +1,10 @@
 #include <gtest/gtest.h>
+#include <map>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include "treemap.h"
 
@@ -47,6 +52,9 @@ TEST(Treemap, ContainsKey) {
 TEST(Treemap, ContainsValue) {
   Treemap<int, char> map;
 
+  /* Empty tree has no values */
+  EXPECT_EQ(map.ContainsValue('A'), false);
+
   /* Checks Contains Value Function */
   map.Insert(23, 'A');
   map.Insert(42, 'B');
@@ -201,6 +209,486 @@ TEST(Treemap, Donor20Test) {
     map.Remove(7000);
     EXPECT_EQ(map.Size(), 16);
 }
+TEST(Treemap, SortedInsertBalanced) {
+  Treemap<int, int> map;
+
+  /* Sorted insertion must not degenerate into a list */
+  const int n = 200000;
+  for (int i = 0; i < n; i++)
+    map.Insert(i, i);
+  EXPECT_EQ(map.Size(), n);
+  // AVL height is at most ~1.44 log2(N)
+  EXPECT_LE(map.Height(), 26);
+  EXPECT_EQ(map.MinKey(), 0);
+  EXPECT_EQ(map.MaxKey(), n - 1);
+  for (int i = n - 1; i >= 0; i -= 2)
+    map.Remove(i);
+  EXPECT_EQ(map.Size(), n / 2);
+  EXPECT_LE(map.Height(), 25);
+  EXPECT_EQ(map.Get(4), 4);
+  EXPECT_EQ(map.ContainsKey(5), false);
+  EXPECT_EQ(map.FloorKey(5), 4);
+  EXPECT_EQ(map.CeilKey(5), 6);
+}
+
+TEST(Treemap, RandomAgainstStdMap) {
+  Treemap<int, int> map;
+  std::map<int, int> ref;
+
+  /* Random inserts and removes agree with std::map */
+  unsigned seed = 12345;
+  for (int i = 0; i < 20000; i++) {
+    seed = seed * 1103515245 + 12345;
+    int key = (seed >> 8) % 2000;
+    if (ref.count(key)) {
+      map.Remove(key);
+      ref.erase(key);
+    } else {
+      map.Insert(key, i);
+      ref[key] = i;
+    }
+  }
+  EXPECT_EQ(map.Size(), ref.size());
+  for (auto& kv : ref)
+    EXPECT_EQ(map.Get(kv.first), kv.second);
+  EXPECT_EQ(map.MinKey(), ref.begin()->first);
+  EXPECT_EQ(map.MaxKey(), ref.rbegin()->first);
+}
+
+TEST(Treemap, StdAllocator) {
+  Treemap<int, int, NoAggregate, std::less<int>,
+      std::allocator<std::pair<const int, int>>> map;
+
+  /* Any standard allocator can replace the node pool */
+  for (int i = 0; i < 1000; i++)
+    map.Insert((i * 7) % 1000, i);
+  for (int i = 0; i < 1000; i += 2)
+    map.Remove(i);
+  EXPECT_EQ(map.Size(), 500);
+  EXPECT_EQ(map.MinKey(), 1);
+  EXPECT_EQ(map.Get(7), 1);
+}
+
+TEST(NodePool, RecyclesSlots) {
+  NodePool<long> pool;
+
+  /* Chunks grow geometrically and freed slots are reused first */
+  std::vector<long*> slots;
+  for (int i = 0; i < 1000; i++)
+    slots.push_back(pool.allocate(1));
+  size_t capacity = pool.Capacity();
+  EXPECT_GE(capacity, 1000);
+  EXPECT_LE(pool.Chunks(), 6);
+  long *last = slots.back();
+  pool.deallocate(last, 1);
+  EXPECT_EQ(pool.allocate(1), last);
+  for (long *slot : slots)
+    pool.deallocate(slot, 1);
+  for (int i = 0; i < 1000; i++)
+    pool.allocate(1);
+  EXPECT_EQ(pool.Capacity(), capacity);
+}
+
+TEST(Treemap, Iterators) {
+  Treemap<int, char> map;
+
+  /* Iterating visits keys in increasing order, in both directions */
+  EXPECT_EQ(map.begin() == map.end(), true);
+  map.Insert(23, 'A');
+  map.Insert(42, 'B');
+  map.Insert(5, 'C');
+  map.Insert(8, 'D');
+  std::vector<int> keys;
+  for (auto& entry : map)
+    keys.push_back(entry.first);
+  EXPECT_EQ(keys, (std::vector<int>{ 5, 8, 23, 42 }));
+  auto it = map.end();
+  --it;
+  EXPECT_EQ(it->first, 42);
+  --it;
+  EXPECT_EQ(it->second, 'A');
+  // Values can be modified through iterators
+  it->second = 'Z';
+  EXPECT_EQ(map.Get(23), 'Z');
+}
+
+TEST(Treemap, BoundsAndRange) {
+  Treemap<int, int> map;
+
+  /* Lower/upper bounds and range scans */
+  for (int i = 0; i < 100; i += 10)
+    map.Insert(i, i / 10);
+  EXPECT_EQ(map.LowerBound(30)->first, 30);
+  EXPECT_EQ(map.UpperBound(30)->first, 40);
+  EXPECT_EQ(map.LowerBound(31)->first, 40);
+  EXPECT_EQ(map.LowerBound(-5)->first, 0);
+  EXPECT_EQ(map.LowerBound(91) == map.end(), true);
+  EXPECT_EQ(map.UpperBound(90) == map.end(), true);
+
+  std::vector<int> values;
+  map.Range(15, 50, [&](const int&, const int& value) {
+    values.push_back(value);
+  });
+  EXPECT_EQ(values, (std::vector<int>{ 2, 3, 4, 5 }));
+  values.clear();
+  map.Range(91, 200, [&](const int&, const int& value) {
+    values.push_back(value);
+  });
+  EXPECT_EQ(values.empty(), true);
+}
+
+TEST(Treemap, Entries) {
+  Treemap<int, char> map;
+
+  /* Single-descent entry lookups */
+  EXPECT_EQ(map.Find(23), nullptr);
+  EXPECT_EQ(map.MinEntry(), nullptr);
+  EXPECT_EQ(map.MaxEntry(), nullptr);
+  EXPECT_EQ(map.FloorEntry(23), nullptr);
+  map.Insert(23, 'A');
+  map.Insert(42, 'B');
+  map.Insert(5, 'C');
+  map.Insert(8, 'D');
+  EXPECT_EQ(map.Find(23)->second, 'A');
+  EXPECT_EQ(map.Find(24), nullptr);
+  EXPECT_EQ(map.FloorEntry(22)->first, 8);
+  EXPECT_EQ(map.FloorEntry(23)->first, 23);
+  EXPECT_EQ(map.FloorEntry(4), nullptr);
+  EXPECT_EQ(map.CeilEntry(9)->second, 'A');
+  EXPECT_EQ(map.CeilEntry(8)->first, 8);
+  EXPECT_EQ(map.CeilEntry(43), nullptr);
+  EXPECT_EQ(map.LowerEntry(23)->first, 8);
+  EXPECT_EQ(map.LowerEntry(5), nullptr);
+  EXPECT_EQ(map.HigherEntry(23)->first, 42);
+  EXPECT_EQ(map.HigherEntry(42), nullptr);
+  EXPECT_EQ(map.MinEntry()->second, 'C');
+  EXPECT_EQ(map.MaxEntry()->second, 'B');
+  map.Find(8)->second = 'E';
+  EXPECT_EQ(map.Get(8), 'E');
+}
+
+TEST(Treemap, BuildFromSorted) {
+  Treemap<int, int> map;
+
+  /* Bulk load builds a perfectly balanced tree */
+  std::vector<std::pair<int, int>> entries;
+  for (int i = 0; i < 1023; i++)
+    entries.push_back(std::make_pair(2 * i, i));
+  map.Insert(1, 1);
+  map.BuildFromSorted(entries);
+  EXPECT_EQ(map.Size(), 1023);
+  EXPECT_EQ(map.Height(), 10);
+  EXPECT_EQ(map.ContainsKey(1), false);
+  EXPECT_EQ(map.Get(100), 50);
+  EXPECT_EQ(map.FloorKey(101), 100);
+  // Still a regular tree afterwards
+  map.Insert(101, -1);
+  map.Remove(0);
+  EXPECT_EQ(map.MinKey(), 2);
+  EXPECT_EQ(map.CeilKey(101), 101);
+
+  // Bad input leaves the map unchanged
+  std::vector<std::pair<int, int>> unsorted{ {1, 1}, {3, 3}, {2, 2} };
+  std::vector<std::pair<int, int>> duplicate{ {1, 1}, {1, 2} };
+  EXPECT_THROW(map.BuildFromSorted(unsorted), std::exception);
+  EXPECT_THROW(map.BuildFromSorted(duplicate), std::exception);
+  EXPECT_EQ(map.Size(), 1023);
+  map.BuildFromSorted(std::vector<std::pair<int, int>>());
+  EXPECT_EQ(map.Empty(), true);
+}
+
+// Value whose copies throw once a given number of them have been made,
+// counting the copies alive
+struct FragileValue {
+  static int copies_left;
+  static int alive;
+  FragileValue() {
+    alive++;
+  }
+  FragileValue(const FragileValue&) {
+    if (copies_left-- == 0)
+      throw std::runtime_error("Copy failed");
+    alive++;
+  }
+  ~FragileValue() {
+    alive--;
+  }
+};
+int FragileValue::copies_left = 0;
+int FragileValue::alive = 0;
+
+TEST(Treemap, BuildFromSortedThrows) {
+  std::vector<std::pair<int, FragileValue>> entries(100);
+  for (int i = 0; i < 100; i++)
+    entries[i].first = i;
+  {
+    Treemap<int, FragileValue, NoAggregate, std::less<int>,
+        std::allocator<std::pair<const int, FragileValue>>> map;
+
+    /* A copy failing partway frees the nodes built so far */
+    FragileValue::copies_left = 50;
+    EXPECT_THROW(map.BuildFromSorted(entries), std::exception);
+    EXPECT_EQ(FragileValue::alive, 100);
+    EXPECT_EQ(map.Empty(), true);
+  }
+  EXPECT_EQ(FragileValue::alive, 100);
+}
+
+TEST(Treemap, OrderStatistics) {
+  Treemap<int, int> map;
+
+  /* Rank, select and range counts stay correct across updates */
+  EXPECT_EQ(map.Rank(10), 0);
+  EXPECT_THROW(map.Select(0), std::exception);
+  for (int i = 0; i < 100; i++)
+    map.Insert(i * 10, i);
+  EXPECT_EQ(map.Rank(0), 0);
+  EXPECT_EQ(map.Rank(55), 6);
+  EXPECT_EQ(map.Rank(60), 6);
+  EXPECT_EQ(map.Rank(10000), 100);
+  EXPECT_EQ(map.Select(0), 0);
+  EXPECT_EQ(map.Select(42), 420);
+  EXPECT_EQ(map.Select(99), 990);
+  EXPECT_THROW(map.Select(100), std::exception);
+  EXPECT_EQ(map.CountRange(100, 200), 11);
+  EXPECT_EQ(map.CountRange(101, 199), 9);
+  EXPECT_EQ(map.CountRange(200, 100), 0);
+  for (int i = 0; i < 100; i += 2)
+    map.Remove(i * 10);
+  EXPECT_EQ(map.Select(0), 10);
+  EXPECT_EQ(map.Select(10), 210);
+  EXPECT_EQ(map.Rank(215), 11);
+  EXPECT_EQ(map.CountRange(0, 990), 50);
+
+  std::vector<std::pair<int, int>> entries;
+  for (int i = 0; i < 10; i++)
+    entries.push_back(std::make_pair(i, i));
+  map.BuildFromSorted(entries);
+  EXPECT_EQ(map.Select(7), 7);
+  EXPECT_EQ(map.Rank(7), 7);
+}
+
+TEST(Treemap, RangeAggregate) {
+  Treemap<int, int, ValueSumAggregate<long>> map;
+
+  /* Range sums stay correct across inserts, removes and rotations */
+  EXPECT_EQ(map.Total(), 0);
+  EXPECT_EQ(map.RangeAggregate(0, 100), 0);
+  for (int i = 1; i <= 100; i++)
+    map.Insert(i, i);
+  EXPECT_EQ(map.Total(), 5050);
+  EXPECT_EQ(map.RangeAggregate(1, 100), 5050);
+  EXPECT_EQ(map.RangeAggregate(10, 20), 165);
+  EXPECT_EQ(map.RangeAggregate(-5, 3), 6);
+  EXPECT_EQ(map.RangeAggregate(98, 1000), 297);
+  EXPECT_EQ(map.RangeAggregate(50, 49), 0);
+  for (int i = 1; i <= 100; i += 2)
+    map.Remove(i);
+  EXPECT_EQ(map.Total(), 2550);
+  EXPECT_EQ(map.RangeAggregate(10, 20), 90);
+
+  Treemap<int, int, ValueMinMaxAggregate<int>> minmax;
+  for (int i = 0; i < 50; i++)
+    minmax.Insert(i, (i * 37) % 50);
+  auto range = minmax.RangeAggregate(10, 12);
+  EXPECT_EQ(range.first, 7);
+  EXPECT_EQ(range.second, 44);
+}
+
+TEST(Treemap, SearchPrefix) {
+  Treemap<int, int, ValueSumAggregate<long>> map;
+
+  /* First key whose running sum of values reaches a bound */
+  auto reaching = [&map](long bound) {
+    return map.SearchPrefix([bound](long sum) { return sum >= bound; });
+  };
+  EXPECT_EQ(reaching(1), nullptr);
+  for (int i = 1; i <= 100; i++)
+    map.Insert(i, i);
+  EXPECT_EQ(reaching(1)->first, 1);
+  EXPECT_EQ(reaching(2)->first, 2);
+  EXPECT_EQ(reaching(55)->first, 10);
+  EXPECT_EQ(reaching(56)->first, 11);
+  EXPECT_EQ(reaching(5050)->first, 100);
+  EXPECT_EQ(reaching(5051), nullptr);
+  for (int i = 1; i <= 100; i += 2)
+    map.Remove(i);
+  EXPECT_EQ(reaching(6)->first, 4);
+  EXPECT_EQ(reaching(7)->first, 6);
+}
+
+TEST(Treemap, ValueIndex) {
+  Treemap<int, std::string> map;
+
+  /* Value lookups give the same answers with and without the index */
+  EXPECT_EQ(map.ContainsValue("Ada"), false);
+  map.IndexValues(true);
+  EXPECT_EQ(map.ContainsValue("Ada"), false);
+  map.Insert(3, "Ada");
+  map.Insert(1, "Grace");
+  map.Insert(2, "Ada");
+  map.Insert(4, "Alan");
+  EXPECT_EQ(map.ContainsValue("Ada"), true);
+  EXPECT_EQ(map.KeysForValue("Ada"), (std::vector<int>{ 2, 3 }));
+  map.Remove(3);
+  EXPECT_EQ(map.KeysForValue("Ada"), (std::vector<int>{ 2 }));
+  map.Remove(2);
+  EXPECT_EQ(map.ContainsValue("Ada"), false);
+  map.BuildFromSorted(std::vector<std::pair<int, std::string>>{
+      { 1, "Edsger" }, { 5, "Barbara" }, { 9, "Edsger" } });
+  EXPECT_EQ(map.ContainsValue("Grace"), false);
+  EXPECT_EQ(map.KeysForValue("Edsger"), (std::vector<int>{ 1, 9 }));
+  map.IndexValues(false);
+  EXPECT_EQ(map.KeysForValue("Edsger"), (std::vector<int>{ 1, 9 }));
+  EXPECT_EQ(map.ContainsValue("Barbara"), true);
+
+  // Values without a std::hash can't be indexed but still work
+  Treemap<int, std::vector<int>> unhashable;
+  unhashable.Insert(1, std::vector<int>{ 1 });
+  EXPECT_EQ(unhashable.ContainsValue(std::vector<int>{ 1 }), true);
+  EXPECT_THROW(unhashable.IndexValues(true), std::exception);
+}
+
+TEST(Treemap, KeyIndex) {
+  Treemap<int, int> map;
+  std::map<int, int> ref;
+
+  /* Exact lookups agree with std::map while the index grows, shrinks
+     and is rebuilt; keys are multiples of 16, which share low bits */
+  map.IndexKeys(true);
+  EXPECT_EQ(map.ContainsKey(0), false);
+  unsigned seed = 12345;
+  for (int i = 0; i < 20000; i++) {
+    seed = seed * 1103515245 + 12345;
+    int key = (seed >> 8) % 3000 * 16;
+    if (ref.count(key)) {
+      map.Remove(key);
+      ref.erase(key);
+    } else {
+      map.Insert(key, i);
+      ref[key] = i;
+    }
+    if (i == 10000) {
+      map.IndexKeys(false);
+      map.IndexKeys(true);
+    }
+  }
+  for (int key = -16; key < 3000 * 16; key += 8) {
+    ASSERT_EQ(map.ContainsKey(key), ref.count(key) == 1);
+    if (ref.count(key)) {
+      ASSERT_EQ(map.Get(key), ref[key]);
+    }
+  }
+  EXPECT_EQ(map.Modify(ref.begin()->first, [](int& value) { value = -1; }),
+      true);
+  EXPECT_EQ(map.Find(ref.begin()->first)->second, -1);
+
+  /* Bulk loads and Clear keep the index in step */
+  map.BuildFromSorted(std::vector<std::pair<int, int>>{
+      { 1, 10 }, { 5, 50 }, { 9, 90 } });
+  EXPECT_EQ(map.Get(5), 50);
+  EXPECT_EQ(map.ContainsKey(16), false);
+  map.Clear();
+  EXPECT_EQ(map.ContainsKey(5), false);
+  map.Insert(5, 55);
+  EXPECT_EQ(map.Get(5), 55);
+
+  // Keys without a std::hash can't be indexed
+  Treemap<std::vector<int>, int> unhashable;
+  EXPECT_THROW(unhashable.IndexKeys(true), std::exception);
+}
+
+TEST(Treemap, Comparator) {
+  Treemap<int, char, NoAggregate, std::greater<int>> map;
+
+  /* Keys are ordered by the comparator, here from largest to smallest */
+  map.Insert(5, 'B');
+  map.Insert(9, 'A');
+  map.Insert(1, 'C');
+  EXPECT_THROW(map.Insert(5, 'D'), std::exception);
+  std::vector<int> keys;
+  for (auto& entry : map)
+    keys.push_back(entry.first);
+  EXPECT_EQ(keys, (std::vector<int>{ 9, 5, 1 }));
+  EXPECT_EQ(map.MinKey(), 9);
+  EXPECT_EQ(map.FloorKey(7), 9);
+  EXPECT_EQ(map.CeilKey(7), 5);
+  EXPECT_EQ(map.Rank(5), 1);
+  EXPECT_THROW(map.BuildFromSorted(std::vector<std::pair<int, char>>{
+      { 1, 'A' }, { 2, 'B' } }), std::exception);
+}
+
+// Orders (amount, donor) keys by amount, then donor, and also compares
+// them with a bare amount
+struct ByAmount {
+  typedef void is_transparent;
+  typedef std::pair<long long, std::string> Key;
+  bool operator()(const Key& a, const Key& b) const {
+    return a < b;
+  }
+  bool operator()(const Key& a, long long amount) const {
+    return a.first < amount;
+  }
+  bool operator()(long long amount, const Key& b) const {
+    return amount < b.first;
+  }
+};
+
+TEST(Treemap, HeterogeneousLookup) {
+  Treemap<std::string, int, NoAggregate, std::less<>> map;
+
+  /* String keys are looked up by std::string_view and C strings */
+  map.Insert("Ada", 1815);
+  map.Insert("Grace", 1906);
+  map.Insert("Alan", 1912);
+  std::string_view grace = "Grace Hopper";
+  EXPECT_EQ(map.Get(grace.substr(0, 5)), 1906);
+  EXPECT_EQ(map.ContainsKey(std::string_view("Alan")), true);
+  EXPECT_EQ(map.ContainsKey("Edsger"), false);
+  EXPECT_EQ(map.FloorKey(std::string_view("B")), "Alan");
+  EXPECT_EQ(map.CeilKey(std::string_view("B")), "Grace");
+  EXPECT_EQ(map.Rank(std::string_view("B")), 2);
+  EXPECT_EQ(map.Find(std::string_view("Ada"))->second, 1815);
+  EXPECT_EQ(map.HigherEntry(std::string_view("Ada"))->first, "Alan");
+  EXPECT_EQ(map.LowerBound(std::string_view("Al"))->first, "Alan");
+
+  /* Composite keys are looked up by their first part */
+  Treemap<ByAmount::Key, int, NoAggregate, ByAmount> donations;
+  donations.Insert(ByAmount::Key(500, "Bob"), 0);
+  donations.Insert(ByAmount::Key(100, "Zoe"), 0);
+  donations.Insert(ByAmount::Key(500, "Amy"), 0);
+  donations.Insert(ByAmount::Key(700, "Kim"), 0);
+  EXPECT_EQ(donations.CountRange(100LL, 500LL), 3);
+  EXPECT_EQ(donations.CeilEntry(500LL)->first.second, "Amy");
+  EXPECT_EQ(donations.FloorEntry(500LL)->first.second, "Bob");
+  EXPECT_EQ(donations.LowerEntry(500LL)->first.second, "Zoe");
+  std::vector<std::string> names;
+  donations.Range(500LL, 500LL,
+      [&names](const ByAmount::Key& key, int) { names.push_back(key.second); });
+  EXPECT_EQ(names, (std::vector<std::string>{ "Amy", "Bob" }));
+}
+
+TEST(Treemap, ModifyAndUpsert) {
+  Treemap<int, int, ValueSumAggregate<int>> map;
+
+  map.IndexValues(true);
+  map.Insert(1, 10);
+  map.Insert(2, 20);
+  EXPECT_EQ(map.Modify(1, [](int& value) { value += 5; }), true);
+  EXPECT_EQ(map.Modify(3, [](int& value) { value += 5; }), false);
+  EXPECT_EQ(map.Get(1), 15);
+  EXPECT_EQ(map.Total(), 35);
+  EXPECT_EQ(map.KeysForValue(15), std::vector<int>({1}));
+  EXPECT_EQ(map.ContainsValue(10), false);
+
+  auto twice = [](int& value) { value *= 2; };
+  map.Upsert(2, 0, twice);
+  map.Upsert(3, 7, twice);
+  EXPECT_EQ(map.Get(2), 40);
+  EXPECT_EQ(map.Get(3), 7);
+  EXPECT_EQ(map.Total(), 62);
+}
+
 int main(int argc, char *argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,245 @@
+#include <gtest/gtest.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "treemultimap.h"
+
+TEST(TreeMultimap, Empty) {
+  TreeMultimap<int, int> map;
+
+  /* Should be fully empty */
+  EXPECT_EQ(map.Empty(), true);
+  EXPECT_EQ(map.Size(), 0);
+  EXPECT_EQ(map.KeyCount(), 0);
+  EXPECT_EQ(map.Count(42), 0);
+  EXPECT_EQ(map.EqualRange(42).first, map.EqualRange(42).second);
+  EXPECT_THROW(map.Get(42), std::exception);
+  EXPECT_THROW(map.Remove(42), std::exception);
+  EXPECT_THROW(map.Select(0), std::exception);
+  EXPECT_EQ(map.Rank(42), 0);
+}
+
+TEST(TreeMultimap, DuplicateKeys) {
+  TreeMultimap<int, std::string> map;
+
+  map.Insert(10, "A");
+  map.Insert(20, "B");
+  map.Insert(10, "C");
+  map.Insert(10, "D");
+  EXPECT_EQ(map.Size(), 4);
+  EXPECT_EQ(map.KeyCount(), 2);
+  EXPECT_EQ(map.Count(10), 3);
+  EXPECT_EQ(map.Get(10), "A");
+
+  // Values of a key keep their insertion order
+  auto range = map.EqualRange(10);
+  std::vector<std::string> values(range.first, range.second);
+  EXPECT_EQ(values, std::vector<std::string>({"A", "C", "D"}));
+
+  // Removing one mapping keeps the others
+  map.Remove(10, "C");
+  EXPECT_EQ(map.Count(10), 2);
+  EXPECT_EQ(map.Size(), 3);
+  EXPECT_THROW(map.Remove(10, "C"), std::exception);
+  // Removing the last value of a key removes the key
+  map.Remove(20, "B");
+  EXPECT_EQ(map.ContainsKey(20), false);
+  EXPECT_EQ(map.KeyCount(), 1);
+  // Removing a key drops all of its values
+  map.Remove(10);
+  EXPECT_EQ(map.Empty(), true);
+}
+
+TEST(TreeMultimap, Lookup) {
+  TreeMultimap<int, char> map;
+
+  map.Insert(5, 'a');
+  map.Insert(5, 'b');
+  map.Insert(9, 'c');
+  map.Insert(1, 'a');
+  EXPECT_EQ(map.MinKey(), 1);
+  EXPECT_EQ(map.MaxKey(), 9);
+  EXPECT_EQ(map.FloorKey(8), 5);
+  EXPECT_EQ(map.CeilKey(6), 9);
+  EXPECT_EQ(map.HigherEntry(5)->first, 9);
+  EXPECT_EQ(map.LowerEntry(5)->first, 1);
+  EXPECT_EQ(map.Find(5)->second.size(), 2);
+  EXPECT_EQ(map.Find(6), nullptr);
+  EXPECT_EQ(map.ContainsValue('b'), true);
+  EXPECT_EQ(map.ContainsValue('z'), false);
+  EXPECT_EQ(map.KeysForValue('a'), std::vector<int>({1, 5}));
+
+  // Iteration visits one run per distinct key
+  std::vector<int> keys;
+  for (auto& run : map)
+    keys.push_back(run.first);
+  EXPECT_EQ(keys, std::vector<int>({1, 5, 9}));
+  // Runs are read-only, so their summaries can't go stale
+  static_assert(std::is_const<
+      std::remove_reference<decltype(*map.begin())>::type>::value,
+      "runs must be const");
+}
+
+TEST(TreeMultimap, OrderStatisticsCountEntries) {
+  TreeMultimap<int, int> map;
+  std::multimap<int, int> expected;
+
+  for (int i = 0; i < 2000; i++) {
+    int key = (i * 7919) % 101;
+    map.Insert(key, i);
+    expected.insert(std::make_pair(key, i));
+  }
+  ASSERT_EQ(map.Size(), expected.size());
+
+  size_t i = 0;
+  for (auto& entry : expected) {
+    ASSERT_EQ(map.Select(i), entry.first);
+    i++;
+  }
+  EXPECT_THROW(map.Select(i), std::exception);
+  for (int key = -1; key < 103; key++) {
+    size_t rank = std::distance(expected.begin(), expected.lower_bound(key));
+    ASSERT_EQ(map.Rank(key), rank);
+    ASSERT_EQ(map.Count(key), expected.count(key));
+  }
+  EXPECT_EQ(map.CountRange(10, 20),
+      std::distance(expected.lower_bound(10), expected.upper_bound(20)));
+}
+
+TEST(TreeMultimap, AggregatesCountEveryEntry) {
+  TreeMultimap<int, std::string, KeySumAggregate<long long>> map;
+
+  map.Insert(100, "A");
+  map.Insert(100, "B");
+  map.Insert(50, "C");
+  map.Insert(300, "D");
+  EXPECT_EQ(map.Total(), 550);
+  EXPECT_EQ(map.RangeAggregate(60, 300), 500);
+
+  // In-place run updates keep the cached aggregates up to date
+  map.Remove(100, "A");
+  EXPECT_EQ(map.Total(), 450);
+  map.Insert(50, "E");
+  EXPECT_EQ(map.RangeAggregate(0, 99), 100);
+}
+
+// Sum of the keys, counting how many entries it was asked to summarize
+struct CountingAggregate : KeySumAggregate<long long> {
+  static size_t calls;
+  template <typename K, typename V>
+  static type Of(const K& key, const V& value) {
+    calls++;
+    return KeySumAggregate<long long>::Of(key, value);
+  }
+};
+size_t CountingAggregate::calls = 0;
+
+TEST(TreeMultimap, LongRun) {
+  TreeMultimap<int, int, CountingAggregate> map;
+
+  for (int key = 0; key < 64; key++)
+    map.Insert(key, key);
+  /* Appending to a run summarizes only the new value, however long the
+     run already is */
+  CountingAggregate::calls = 0;
+  const int kValues = 100000;
+  for (int i = 0; i < kValues; i++)
+    map.Insert(40, i);
+  EXPECT_EQ(CountingAggregate::calls, kValues);
+  EXPECT_EQ(map.Count(40), kValues + 1);
+  EXPECT_EQ(map.Size(), 64 + kValues);
+  EXPECT_EQ(map.Total(), 63 * 64 / 2 + 40LL * kValues);
+  EXPECT_EQ(map.RangeAggregate(40, 40), 40LL * (kValues + 1));
+  EXPECT_EQ(map.Rank(41), 41 + kValues);
+  EXPECT_EQ(map.Select(40 + kValues), 40);
+
+  /* Removing a value resummarizes its run */
+  map.Remove(40, 7);
+  EXPECT_EQ(map.RangeAggregate(40, 40), 40LL * kValues);
+  EXPECT_EQ(map.Total(), 63 * 64 / 2 + 40LL * (kValues - 1));
+}
+
+TEST(TreeMultimap, ValueIndex) {
+  TreeMultimap<int, std::string> map;
+  TreeMultimap<int, std::string> indexed;
+
+  indexed.IndexValues(true);
+  for (int i = 0; i < 3000; i++) {
+    int key = (i * 7919) % 97;
+    std::string value = "v" + std::to_string(i % 31);
+    map.Insert(key, value);
+    indexed.Insert(key, value);
+  }
+  /* Removing single mappings and whole keys keeps the index in step */
+  for (int i = 0; i < 500; i++) {
+    int key = (i * 7919) % 97;
+    std::string value = "v" + std::to_string(i % 31);
+    map.Remove(key, value);
+    indexed.Remove(key, value);
+  }
+  map.Remove(5);
+  indexed.Remove(5);
+  for (int i = 0; i < 33; i++) {
+    std::string value = "v" + std::to_string(i);
+    ASSERT_EQ(indexed.KeysForValue(value), map.KeysForValue(value));
+    ASSERT_EQ(indexed.ContainsValue(value), map.ContainsValue(value));
+  }
+
+  /* The index is rebuilt on bulk loads and emptied with the map */
+  indexed.BuildFromSorted(std::vector<std::pair<int, std::string>>{
+      {1, "A"}, {2, "B"}, {2, "A"}, {2, "A"}});
+  EXPECT_EQ(indexed.KeysForValue("A"), std::vector<int>({1, 2, 2}));
+  EXPECT_EQ(indexed.ContainsValue("v1"), false);
+  indexed.Clear();
+  EXPECT_EQ(indexed.KeysForValue("A"), std::vector<int>());
+
+  /* Enabling it on a filled map indexes what is already there */
+  map.IndexValues(true);
+  map.Insert(1000, "v7");
+  EXPECT_EQ(map.KeysForValue("v7").back(), 1000);
+  EXPECT_EQ(map.ContainsValue("nobody"), false);
+}
+
+TEST(TreeMultimap, BuildFromSorted) {
+  TreeMultimap<int, char> map;
+  std::vector<std::pair<int, char>> sorted = {
+    {1, 'a'}, {2, 'b'}, {2, 'c'}, {2, 'd'}, {7, 'e'}, {7, 'f'}
+  };
+
+  map.Insert(3, 'z');
+  map.BuildFromSorted(sorted);
+  EXPECT_EQ(map.Size(), 6);
+  EXPECT_EQ(map.KeyCount(), 3);
+  EXPECT_EQ(map.ContainsKey(3), false);
+  auto range = map.EqualRange(2);
+  EXPECT_EQ(std::string(range.first, range.second), "bcd");
+
+  // Unsorted input is rejected and leaves the map unchanged
+  std::vector<std::pair<int, char>> unsorted = {{2, 'a'}, {1, 'b'}};
+  EXPECT_THROW(map.BuildFromSorted(unsorted), std::exception);
+  EXPECT_EQ(map.Size(), 6);
+}
+
+TEST(TreeMultimap, Comparator) {
+  TreeMultimap<int, std::string, NoAggregate, std::greater<int>> map;
+
+  /* Keys run from largest to smallest, values in insertion order */
+  map.BuildFromSorted(std::vector<std::pair<int, std::string>>{
+      { 9, "A" }, { 9, "B" }, { 4, "C" } });
+  map.Insert(6, "D");
+  EXPECT_EQ(map.MinKey(), 9);
+  EXPECT_EQ(map.Rank(6), 2);
+  EXPECT_EQ(map.HigherEntry(9)->first, 6);
+  EXPECT_THROW(map.BuildFromSorted(std::vector<std::pair<int, std::string>>{
+      { 1, "A" }, { 2, "B" } }), std::exception);
+  EXPECT_EQ(map.Size(), 4);
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
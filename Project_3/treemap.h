@@ -3,15 +3,123 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <memory>
-#include <queue>
 #include <sstream>
 #include <stack>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
+#include "node_pool.h"
 
-template <typename K, typename V>
+// * Aggregate policies
+// A policy summarizes a subtree for Treemap's A template parameter: it
+// names the summary type, the summary of a single entry (Of), and an
+// associative Combine with an Identity element. Summaries are kept in
+// every node and maintained on Insert/Remove/rotations, which allows
+// RangeAggregate queries in O(log N).
+
+// Default policy: no summary is kept (costs no space in the nodes)
+struct NoAggregate {
+  struct type {};
+  template <typename K, typename V>
+  static type Of(const K&, const V&) {
+    return type();
+  }
+  static type Identity() {
+    return type();
+  }
+  static type Combine(const type&, const type&) {
+    return type();
+  }
+};
+
+// Sum of the keys, accumulated as T
+template <typename T>
+struct KeySumAggregate {
+  typedef T type;
+  template <typename K, typename V>
+  static type Of(const K& key, const V&) {
+    return static_cast<T>(key);
+  }
+  static type Identity() {
+    return T();
+  }
+  static type Combine(const type& a, const type& b) {
+    return a + b;
+  }
+};
+
+// Sum of the values, accumulated as T
+template <typename T>
+struct ValueSumAggregate {
+  typedef T type;
+  template <typename K, typename V>
+  static type Of(const K&, const V& value) {
+    return static_cast<T>(value);
+  }
+  static type Identity() {
+    return T();
+  }
+  static type Combine(const type& a, const type& b) {
+    return a + b;
+  }
+};
+
+// Min and max of the values
+template <typename T>
+struct ValueMinMaxAggregate {
+  typedef std::pair<T, T> type;
+  template <typename K, typename V>
+  static type Of(const K&, const V& value) {
+    return type(value, value);
+  }
+  static type Identity() {
+    return type(std::numeric_limits<T>::max(),
+        std::numeric_limits<T>::lowest());
+  }
+  static type Combine(const type& a, const type& b) {
+    return type(std::min(a.first, b.first), std::max(a.second, b.second));
+  }
+};
+
+// Hashes values for Treemap's value index, when std::hash supports them
+template <typename V,
+    bool = std::is_default_constructible<std::hash<V>>::value>
+struct ValueHasher {
+  static const bool kHashable = true;
+  size_t operator()(const V& value) const {
+    return std::hash<V>()(value);
+  }
+};
+template <typename V>
+struct ValueHasher<V, false> {
+  static const bool kHashable = false;
+  size_t operator()(const V&) const {
+    return 0;
+  }
+};
+
+// Whether comparator C is transparent (declares is_transparent, as
+// std::less<> does), so that it can compare keys with other types
+template <typename C, typename = void>
+struct IsTransparent : std::false_type {};
+template <typename C>
+struct IsTransparent<C, std::void_t<typename C::is_transparent>>
+    : std::true_type {};
+
+// Keys are ordered by the comparator C, a strict weak ordering: two keys
+// are the same key when neither compares less than the other
+template <typename K, typename V, typename A = NoAggregate,
+    typename C = std::less<K>,
+    typename Alloc = NodePool<std::pair<const K, V>>>
 class Treemap {
  public:
   //
@@ -26,292 +134,1318 @@ class Treemap {
   bool Empty();
 
   // * Modifiers
-  // Inserts @key in map --O(log N) on average
+  // Inserts @key in map --O(log N)
   // Throws exception if key already exists
   void Insert(const K& key, const V& value);
 
-  // Remove @key from map --O(log N) on average
+  // Remove @key from map --O(log N)
   // Throws exception if key doesn't exists
   void Remove(const K& key);
 
   // * Lookup
-  // Return value corresponding to @key --O(log N) on average
+  // Return value corresponding to @key --O(log N)
   // Throws exception if tree is empty or key doesn't exists
   const V& Get(const K& key);
 
-  // Return greatest key less than or equal to @key --O(log N) on average
+  // Return greatest key less than or equal to @key --O(log N)
   // Throws exception if tree is empty or no floor exists for key
   const K& FloorKey(const K& key);
 
-  // Return least key greater than or equal to @key --O(log N) on average
+  // Return least key greater than or equal to @key --O(log N)
   // Throws exception if tree is empty or no ceil exists for key
   const K& CeilKey(const K& key);
 
-  // Return whether @key is found in map --O(log N) on average
+  // Return whether @key is found in map --O(log N)
   bool ContainsKey(const K& key);
 
-  // Return whether @value is found in map --O(N)
+  // Return whether @value is found in map --O(N), O(1) expected with the
+  // value index
   bool ContainsValue(const V& value);
 
-  // Return max key in map --O(log N) on average
+  // Return max key in map --O(log N)
   // Throws exception if tree is empty
   const K& MaxKey();
 
-  // Return min key in map --O(log N) on average
+  // Return min key in map --O(log N)
   // Throws exception if tree is empty
   const K& MinKey();
 
+  //
+  // Extensions to the original API
+  //
+
+  // Constructor/Destructor
+  Treemap() = default;
+  // Orders keys with @comp
+  explicit Treemap(const C& comp) : comp(comp) {}
+  ~Treemap();
+  Treemap(const Treemap&) = delete;
+  Treemap& operator=(const Treemap&) = delete;
+
+  // Return number of levels in the tree, 0 if empty --O(1)
+  size_t Height();
+
+  // Return the comparator ordering the keys --O(1)
+  const C& KeyComp() const {
+    return comp;
+  }
+
+  // * Value index
+  // Build (or drop) a hash index from values to their nodes, maintained on
+  // every insert and remove. It costs about two pointers plus a hash per
+  // entry. Values modified in place through iterators or entry pointers
+  // are not re-indexed. --O(N)
+  // Throws exception if enabled for values std::hash doesn't support
+  void IndexValues(bool enable);
+
+  // Return keys mapped to @value, in increasing order --O(N), O(k log k)
+  // expected with the value index
+  std::vector<K> KeysForValue(const V& value);
+
+  // * Key index
+  // Build (or drop) an open-addressing hash index from keys to their
+  // nodes, maintained on every insert and remove. Exact lookups (Get,
+  // Find, ContainsKey, Modify, Remove) then take O(1) expected probes
+  // instead of a walk down the tree; ordered queries still use the tree.
+  // It costs two words per slot, with at least half of the slots free.
+  // Keys that C considers the same must hash the same. --O(N)
+  // Throws exception if enabled for keys std::hash doesn't support
+  void IndexKeys(bool enable);
+
+  // * Order statistics
+  // Return number of keys strictly less than @key --O(log N)
+  size_t Rank(const K& key);
+  // Return the @i-th smallest key, counting from 0 --O(log N)
+  // Throws exception if @i is not less than Size()
+  const K& Select(size_t i);
+  // Return number of keys in [@lo, @hi] --O(log N)
+  size_t CountRange(const K& lo, const K& hi);
+
+  // * Aggregates
+  typedef typename A::type Aggregate;
+  // Return summary of all entries --O(1)
+  Aggregate Total();
+  // Return summary of the entries with @lo <= key <= @hi, combined in
+  // increasing key order --O(log N)
+  Aggregate RangeAggregate(const K& lo, const K& hi);
+
+  // * In-place modifiers
+  // Apply @update(V&) to the value mapped to @key, keeping aggregates and
+  // the value index up to date --O(log N)
+  // Returns false if key doesn't exist
+  template <typename F>
+  bool Modify(const K& key, F update);
+  // Same as Modify, but inserts @key with @value if it doesn't exist
+  // --O(log N)
+  template <typename F>
+  void Upsert(const K& key, const V& value, F update);
+
+  // * Bulk modifiers
+  // Remove all entries --O(N)
+  void Clear();
+
+  // Replace contents with the (key, value) pairs in [first, last), which
+  // must be sorted by strictly increasing key, as a perfectly balanced
+  // tree --O(N)
+  // Throws exception (leaving map unchanged) if keys are out of order or
+  // duplicated
+  template <typename It>
+  void BuildFromSorted(It first, It last);
+  // Same as above for every pair of @range
+  template <typename R>
+  void BuildFromSorted(const R& range);
+
+  // * Entry lookup
+  // Each of these walks the tree once and returns a pointer to the
+  // matching key-value pair (value modifiable), or nullptr if none
+  typedef std::pair<const K, V> Entry;
+
+  // Return entry for @key --O(log N)
+  Entry *Find(const K& key);
+  // Return entry with the greatest key less than or equal to @key --O(log N)
+  Entry *FloorEntry(const K& key);
+  // Return entry with the least key greater than or equal to @key --O(log N)
+  Entry *CeilEntry(const K& key);
+  // Return entry with the greatest key strictly less than @key --O(log N)
+  Entry *LowerEntry(const K& key);
+  // Return entry with the least key strictly greater than @key --O(log N)
+  Entry *HigherEntry(const K& key);
+  // Return entry with the min/max key --O(log N)
+  Entry *MinEntry();
+  Entry *MaxEntry();
+  // Return the first entry at which @reached(prefix) holds, where prefix
+  // summarizes the entries from the min key up to and including it;
+  // @reached must hold for every longer prefix too. nullptr if none
+  // --O(log N)
+  template <typename F>
+  Entry *SearchPrefix(F reached);
+
+  // * Iteration
+  class Iterator;
+  typedef Iterator iterator;
+
+  // Return iterator to the entry with the min key --O(log N)
+  Iterator begin();
+  // Return iterator past the entry with the max key --O(1)
+  Iterator end();
+
+  // Return iterator to the first entry whose key is not less than @key,
+  // end() if none --O(log N)
+  Iterator LowerBound(const K& key);
+  // Return iterator to the first entry whose key is greater than @key,
+  // end() if none --O(log N)
+  Iterator UpperBound(const K& key);
+
+  // Call @callback(key, value) on every entry with @lo <= key <= @hi in
+  // increasing key order --O(log N + number of entries visited)
+  template <typename F>
+  void Range(const K& lo, const K& hi, F callback);
+
+  // * Heterogeneous lookup
+  // When C is transparent, the lookups above also take a key of any type
+  // Q that C can compare with K, such as a std::string_view for
+  // std::string keys, which is never converted to K. Same behavior and
+  // complexity as with a K (the K versions call these with Q = K), except
+  // that only K lookups use the key index
+  template <typename Q>
+  using EnableLookup = typename std::enable_if<IsTransparent<C>::value ||
+      std::is_same<Q, K>::value>::type;
+
+  template <typename Q, typename = EnableLookup<Q>>
+  const V& Get(const Q& key);
+  template <typename Q, typename = EnableLookup<Q>>
+  const K& FloorKey(const Q& key);
+  template <typename Q, typename = EnableLookup<Q>>
+  const K& CeilKey(const Q& key);
+  template <typename Q, typename = EnableLookup<Q>>
+  bool ContainsKey(const Q& key);
+  template <typename Q, typename = EnableLookup<Q>>
+  size_t Rank(const Q& key);
+  template <typename Q, typename = EnableLookup<Q>>
+  size_t CountRange(const Q& lo, const Q& hi);
+  template <typename Q, typename = EnableLookup<Q>>
+  Aggregate RangeAggregate(const Q& lo, const Q& hi);
+  template <typename Q, typename = EnableLookup<Q>>
+  Entry *Find(const Q& key);
+  template <typename Q, typename = EnableLookup<Q>>
+  Entry *FloorEntry(const Q& key);
+  template <typename Q, typename = EnableLookup<Q>>
+  Entry *CeilEntry(const Q& key);
+  template <typename Q, typename = EnableLookup<Q>>
+  Entry *LowerEntry(const Q& key);
+  template <typename Q, typename = EnableLookup<Q>>
+  Entry *HigherEntry(const Q& key);
+  template <typename Q, typename = EnableLookup<Q>>
+  Iterator LowerBound(const Q& key);
+  template <typename Q, typename = EnableLookup<Q>>
+  Iterator UpperBound(const Q& key);
+  template <typename Q, typename F, typename = EnableLookup<Q>>
+  void Range(const Q& lo, const Q& hi, F callback);
+
  private:
   //
   // @@@ The class's internal members below can be modified @@@
   //
 
   // Private member variables
-  // ...To be completed...
+  // The tree is kept AVL-balanced: the heights of the two subtrees of any
+  // node differ by at most one, so every path is O(log N) long even when
+  // keys are inserted in sorted order. Nodes link to their parent so that
+  // all operations can walk back up without recursion, and count the
+  // nodes in their subtree so that entries can be located by rank.
   struct Node {
-    K key;
-    V value;
-    std::unique_ptr<Node> left;
-    std::unique_ptr<Node> right;
+    Node(const K& key, const V& value, Node *parent)
+        : entry(key, value), parent(parent), agg(A::Of(key, value)) {}
+    std::pair<const K, V> entry;
+    Node *left = nullptr;
+    Node *right = nullptr;
+    Node *parent;
+    int height = 1;
+    Aggregate agg;
+    size_t size = 1;
   };
-  std::unique_ptr<Node> root;
+  Node *root = nullptr;
   size_t cur_size = 0;
+  C comp;
+  // Nodes come from Alloc rebound to Node; the default NodePool keeps
+  // them contiguous and recycles the ones removed
+  typedef typename std::allocator_traits<Alloc>::template
+      rebind_alloc<Node> NodeAlloc;
+  typedef std::allocator_traits<NodeAlloc> NodeTraits;
+  NodeAlloc node_alloc;
+  // Value hash -> node, only allocated while the index is enabled
+  typedef std::unordered_multimap<size_t, Node*> ValueIndex;
+  std::unique_ptr<ValueIndex> value_index;
+  // Key -> node, with linear probing over a power of two number of slots
+  // and keys spread by KeySlotHash; only allocated while enabled
+  struct KeySlot {
+    size_t hash;
+    Node *node = nullptr;  // nullptr if the slot is free
+  };
+  struct KeyIndex {
+    std::vector<KeySlot> slots;
+    size_t count = 0;
+  };
+  std::unique_ptr<KeyIndex> key_index;
   // Private constants
-  // ...To be completed (if any)...
+  // Smallest number of slots of the key index
+  static const size_t kMinKeySlots = 16;
 
   // Private methods
-  // ...To be completed (if any)...
-  Node *Min(Node *n);
+  static Node *Min(Node *n);
+
+  static Node *Max(Node *n);
+
+  // Return in-order neighbours of @n, nullptr if none --O(1) amortized
+  static Node *Next(Node *n);
+  static Node *Prev(Node *n);
+
+  // Allocate and construct a node / destroy and release it
+  Node *NewNode(const K& key, const V& value, Node *parent);
+  void DeleteNode(Node *n);
+
+  // Return node holding @key, nullptr if none
+  template <typename Q>
+  Node *FindNode(const Q& key);
+  // Return node with the greatest key <= @key (or < @key if @strict),
+  // nullptr if none
+  template <typename Q>
+  Node *FloorNode(const Q& key, bool strict);
+  // Return node with the least key >= @key (or > @key if @strict),
+  // nullptr if none
+  template <typename Q>
+  Node *CeilNode(const Q& key, bool strict);
+  // * Helper methods for the value index
+  void IndexNode(Node *n);
+  void UnindexNode(Node *n);
+  // * Helper methods for the key index
+  // Return std::hash of @key with its bits mixed, since the slot is taken
+  // from the low bits and std::hash of integers is the identity
+  static size_t KeySlotHash(const K& key);
+  Node *FindIndexedNode(const K& key);
+  void IndexKey(Node *n);
+  void UnindexKey(Node *n);
+  // Rehash the key index into the fewest slots (a power of two) that
+  // keep at least half of them free with @count keys
+  void ResizeKeyIndex(size_t count);
+  // Applies @update to the value of @n and refreshes what depends on it
+  template <typename F>
+  void ModifyNode(Node *n, F update);
+
+  // Links nodes[lo, hi) into a balanced subtree under @parent
+  Node *LinkBalanced(const std::vector<Node*>& nodes, size_t lo,
+      size_t hi, Node *parent);
+  // Return entry of @n, nullptr if @n is null
+  static Entry *EntryOf(Node *n) {
+    return n ? &n->entry : nullptr;
+  }
 
-  Node *Max(Node *n);
+  // * Helper methods for balancing
+  static int HeightOf(Node *n) {
+    return n ? n->height : 0;
+  }
+  static size_t SizeOf(Node *n) {
+    return n ? n->size : 0;
+  }
+  static Aggregate AggregateOf(Node *n) {
+    return n ? n->agg : A::Identity();
+  }
+  static Aggregate EntryAggregate(Node *n) {
+    return A::Of(n->entry.first, n->entry.second);
+  }
+  // Recomputes the cached fields of @n from its children
+  void Update(Node *n);
+  // Puts @child (possibly null) in the place of @n under n's parent
+  void Replace(Node *n, Node *child);
+  // Rotates @n down to the left/right, returns the new subtree root
+  Node *RotateLeft(Node *n);
+  Node *RotateRight(Node *n);
+  // Restores balance from @n up to the root after a modification
+  void Rebalance(Node *n);
+};
 
-  void Insert(std::unique_ptr<Node>& n, const K& key, const V& value);
+// Bidirectional iterator over the entries in increasing key order. Keys
+// are read-only, values can be modified in place. Only invalidated by the
+// removal of the entry it points to.
+template <typename K, typename V, typename A, typename C, typename Alloc>
+class Treemap<K, V, A, C, Alloc>::Iterator {
+ public:
+  typedef std::bidirectional_iterator_tag iterator_category;
+  typedef std::pair<const K, V> value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef value_type* pointer;
+  typedef value_type& reference;
+
+  Iterator() = default;
 
-  void Remove(std::unique_ptr<Node>& n, const K& key);
+  reference operator*() const {
+    return n->entry;
+  }
+  pointer operator->() const {
+    return &n->entry;
+  }
+  Iterator& operator++() {
+    n = Next(n);
+    return *this;
+  }
+  Iterator operator++(int) {
+    Iterator prev = *this;
+    ++*this;
+    return prev;
+  }
+  // Decrementing end() moves to the entry with the max key
+  Iterator& operator--() {
+    n = n ? Prev(n) : Max(map->root);
+    return *this;
+  }
+  Iterator operator--(int) {
+    Iterator next = *this;
+    --*this;
+    return next;
+  }
+  bool operator==(const Iterator& other) const {
+    return n == other.n;
+  }
+  bool operator!=(const Iterator& other) const {
+    return n != other.n;
+  }
+
+ private:
+  friend class Treemap;
+  Iterator(Node *n, Treemap *map) : n(n), map(map) {}
+
+  Node *n = nullptr;
+  Treemap *map = nullptr;
 };
 
 //
 // Your implementation of the class should be located below
 //
 // ...To be completed...
-template <typename K, typename V>
-size_t Treemap<K, V>::Size() {
+template <typename K, typename V, typename A, typename C, typename Alloc>
+Treemap<K, V, A, C, Alloc>::~Treemap() {
+  Clear();
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+size_t Treemap<K, V, A, C, Alloc>::Rank(const K& key) {
+  return Rank<K>(key);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+size_t Treemap<K, V, A, C, Alloc>::Rank(const Q& key) {
+  size_t rank = 0;
+  Node *n = root;
+  while (n) {
+    // Going right skips the node and its whole left subtree
+    if (comp(n->entry.first, key)) {
+      rank += SizeOf(n->left) + 1;
+      n = n->right;
+    } else {
+      n = n->left;
+    }
+  }
+  return rank;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+const K& Treemap<K, V, A, C, Alloc>::Select(size_t i) {
+  if (i >= cur_size)
+    throw std::out_of_range("Out of range!");
+  Node *n = root;
+  while (true) {
+    size_t left_size = SizeOf(n->left);
+    if (i < left_size) {
+      n = n->left;
+    } else if (i == left_size) {
+      return n->entry.first;
+    } else {
+      i -= left_size + 1;
+      n = n->right;
+    }
+  }
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+size_t Treemap<K, V, A, C, Alloc>::CountRange(const K& lo, const K& hi) {
+  return CountRange<K>(lo, hi);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+size_t Treemap<K, V, A, C, Alloc>::CountRange(const Q& lo, const Q& hi) {
+  // Count keys <= hi like Rank counts keys < lo; with a transparent C
+  // several keys may compare equal to hi
+  size_t upto_hi = 0;
+  Node *n = root;
+  while (n) {
+    if (comp(hi, n->entry.first)) {
+      n = n->left;
+    } else {
+      upto_hi += SizeOf(n->left) + 1;
+      n = n->right;
+    }
+  }
+  size_t below_lo = Rank(lo);
+  return upto_hi > below_lo ? upto_hi - below_lo : 0;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename
+Treemap<K, V, A, C, Alloc>::Aggregate Treemap<K, V, A, C, Alloc>::Total() {
+  return AggregateOf(root);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Aggregate
+Treemap<K, V, A, C, Alloc>::RangeAggregate(const K& lo, const K& hi) {
+  return RangeAggregate<K>(lo, hi);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+typename Treemap<K, V, A, C, Alloc>::Aggregate
+Treemap<K, V, A, C, Alloc>::RangeAggregate(const Q& lo, const Q& hi) {
+  // Find the highest node inside [lo, hi], where the paths to lo and hi
+  // split
+  Node *split = root;
+  while (split && (comp(split->entry.first, lo) ||
+      comp(hi, split->entry.first)))
+    split = comp(split->entry.first, lo) ? split->right : split->left;
+  if (!split)
+    return A::Identity();
+
+  // Down the path to lo, every node >= lo is in range together with its
+  // right subtree; they come after what is found further down
+  Aggregate left = A::Identity();
+  for (Node *n = split->left; n;) {
+    if (comp(n->entry.first, lo)) {
+      n = n->right;
+    } else {
+      left = A::Combine(A::Combine(EntryAggregate(n), AggregateOf(n->right)),
+          left);
+      n = n->left;
+    }
+  }
+  // Mirror image down the path to hi
+  Aggregate right = A::Identity();
+  for (Node *n = split->right; n;) {
+    if (comp(hi, n->entry.first)) {
+      n = n->left;
+    } else {
+      right = A::Combine(right,
+          A::Combine(AggregateOf(n->left), EntryAggregate(n)));
+      n = n->right;
+    }
+  }
+  return A::Combine(A::Combine(left, EntryAggregate(split)), right);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename F>
+typename Treemap<K, V, A, C, Alloc>::Entry *
+Treemap<K, V, A, C, Alloc>::SearchPrefix(F reached) {
+  // Single descent: before is the summary of every entry left of n's
+  // subtree, which never reaches
+  Aggregate before = A::Identity();
+  Node *n = root;
+  while (n) {
+    Aggregate left = A::Combine(before, AggregateOf(n->left));
+    if (n->left && reached(left)) {
+      n = n->left;
+      continue;
+    }
+    Aggregate through = A::Combine(left, EntryAggregate(n));
+    if (reached(through))
+      return &n->entry;
+    before = through;
+    n = n->right;
+  }
+  return nullptr;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::Clear() {
+  // Post-order deletion by walking parent links, without a stack
+  Node *n = root;
+  while (n) {
+    if (n->left) {
+      n = n->left;
+    } else if (n->right) {
+      n = n->right;
+    } else {
+      Node *parent = n->parent;
+      if (parent) {
+        if (parent->left == n)
+          parent->left = nullptr;
+        else
+          parent->right = nullptr;
+      }
+      DeleteNode(n);
+      n = parent;
+    }
+  }
+  root = nullptr;
+  cur_size = 0;
+  if (value_index)
+    value_index->clear();
+  if (key_index) {
+    key_index->slots.assign(kMinKeySlots, KeySlot());
+    key_index->count = 0;
+  }
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename It>
+void Treemap<K, V, A, C, Alloc>::BuildFromSorted(It first, It last) {
+  // Allocate all nodes in key order first, checking the order as we go.
+  // If anything throws, the nodes allocated so far are freed
+  std::vector<Node*> nodes;
+  try {
+    for (It it = first; it != last; ++it) {
+      if (!nodes.empty() && !comp(nodes.back()->entry.first, it->first)) {
+        if (comp(it->first, nodes.back()->entry.first))
+          throw std::invalid_argument("Unsorted keys");
+        throw std::invalid_argument("Duplicate Key");
+      }
+      // The slot is taken first, so that the node is never left out
+      nodes.push_back(nullptr);
+      nodes.back() = NewNode(it->first, it->second, nullptr);
+    }
+  } catch (...) {
+    for (Node *n : nodes) {
+      if (n)
+        DeleteNode(n);
+    }
+    throw;
+  }
+  // Then link them, with each middle node as the root of its range
+  Clear();
+  root = LinkBalanced(nodes, 0, nodes.size(), nullptr);
+  cur_size = nodes.size();
+  if (value_index) {
+    value_index->reserve(cur_size);
+    for (Node *n : nodes)
+      IndexNode(n);
+  }
+  if (key_index) {
+    ResizeKeyIndex(cur_size);
+    for (Node *n : nodes)
+      IndexKey(n);
+  }
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename R>
+void Treemap<K, V, A, C, Alloc>::BuildFromSorted(const R& range) {
+  BuildFromSorted(std::begin(range), std::end(range));
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Node*
+Treemap<K, V, A, C, Alloc>::LinkBalanced(const std::vector<Node*>& nodes,
+    size_t lo, size_t hi, Node *parent) {
+  // Recursion depth is only log2(N) as each range is halved
+  if (lo == hi)
+    return nullptr;
+  size_t mid = lo + (hi - lo) / 2;
+  Node *n = nodes[mid];
+  n->parent = parent;
+  n->left = LinkBalanced(nodes, lo, mid, n);
+  n->right = LinkBalanced(nodes, mid + 1, hi, n);
+  Update(n);
+  return n;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+size_t Treemap<K, V, A, C, Alloc>::Size() {
   return cur_size;
 }
-template <typename K, typename V>
-bool Treemap<K, V>::Empty() {
+template <typename K, typename V, typename A, typename C, typename Alloc>
+bool Treemap<K, V, A, C, Alloc>::Empty() {
   return cur_size == 0;
 }
 
-template <typename K, typename V>
-void Treemap<K, V>::Insert(const K& key, const V& value) {
-  Insert(root, key, value);
-}
-
-template <typename K, typename V>
-void Treemap<K, V>::Insert(std::unique_ptr<Node>& n,
-  const K& key, const V& value) {
-  // If node doesnt exist in tree, insert the node
-  if (!n) {
-    n = std::unique_ptr<Node>(new Node{ key, value });
-    cur_size++;
-  // If input key is less than node, move left
-  } else if (key < n->key) {
-    Insert(n->left, key, value);
-  // If input key is greater than node, move right
-  } else if (key > n->key) {
-    Insert(n->right, key, value);
-  // Otherwise (key == node) throw error
-  } else {
-    throw std::invalid_argument("Duplicate Key");
+template <typename K, typename V, typename A, typename C, typename Alloc>
+size_t Treemap<K, V, A, C, Alloc>::Height() {
+  return HeightOf(root);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename
+Treemap<K, V, A, C, Alloc>::Iterator Treemap<K, V, A, C, Alloc>::begin() {
+  return Iterator(root ? Min(root) : nullptr, this);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename
+Treemap<K, V, A, C, Alloc>::Iterator Treemap<K, V, A, C, Alloc>::end() {
+  return Iterator(nullptr, this);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Iterator
+Treemap<K, V, A, C, Alloc>::LowerBound(const K& key) {
+  return LowerBound<K>(key);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+typename Treemap<K, V, A, C, Alloc>::Iterator
+Treemap<K, V, A, C, Alloc>::LowerBound(const Q& key) {
+  return Iterator(CeilNode(key, false), this);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Iterator
+Treemap<K, V, A, C, Alloc>::UpperBound(const K& key) {
+  return UpperBound<K>(key);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+typename Treemap<K, V, A, C, Alloc>::Iterator
+Treemap<K, V, A, C, Alloc>::UpperBound(const Q& key) {
+  return Iterator(CeilNode(key, true), this);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename F>
+void Treemap<K, V, A, C, Alloc>::Range(const K& lo, const K& hi, F callback) {
+  Range<K>(lo, hi, callback);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename F, typename>
+void Treemap<K, V, A, C, Alloc>::Range(const Q& lo, const Q& hi, F callback) {
+  // One descent to find the start, then successor steps, which visit
+  // each edge of the scanned region at most twice
+  for (Node *n = CeilNode(lo, false); n && !comp(hi, n->entry.first);
+      n = Next(n))
+    callback(n->entry.first, n->entry.second);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::Insert(const K& key, const V& value) {
+  Node *parent = nullptr;
+  Node **link = &root;
+  while (*link) {
+    parent = *link;
+    // If input key is less than node, move left
+    if (comp(key, parent->entry.first))
+      link = &parent->left;
+    // If input key is greater than node, move right
+    else if (comp(parent->entry.first, key))
+      link = &parent->right;
+    // Otherwise (key == node) throw error
+    else
+      throw std::invalid_argument("Duplicate Key");
+  }
+  // Key doesn't exist in tree, attach a new leaf and rebalance above it
+  *link = NewNode(key, value, parent);
+  cur_size++;
+  IndexNode(*link);
+  IndexKey(*link);
+  Rebalance(parent);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename F>
+bool Treemap<K, V, A, C, Alloc>::Modify(const K& key, F update) {
+  Node *n = FindNode(key);
+  if (!n)
+    return false;
+  ModifyNode(n, update);
+  return true;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename F>
+void Treemap<K, V, A, C, Alloc>::Upsert(const K& key, const V& value,
+    F update) {
+  // Same descent as Insert, but an existing key is updated in place
+  Node *parent = nullptr;
+  Node **link = &root;
+  while (*link) {
+    parent = *link;
+    if (comp(key, parent->entry.first)) {
+      link = &parent->left;
+    } else if (comp(parent->entry.first, key)) {
+      link = &parent->right;
+    } else {
+      ModifyNode(parent, update);
+      return;
+    }
   }
+  *link = NewNode(key, value, parent);
+  cur_size++;
+  IndexNode(*link);
+  IndexKey(*link);
+  Rebalance(parent);
 }
 
-template <typename K, typename V>
-void Treemap<K, V>::Remove(const K& key) {
-  Remove(root, key);
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename F>
+void Treemap<K, V, A, C, Alloc>::ModifyNode(Node *n, F update) {
+  UnindexNode(n);
+  update(n->entry.second);
+  IndexNode(n);
+  // The tree shape is unchanged, only the cached aggregates above n
+  for (Node *p = n; p; p = p->parent)
+    Update(p);
 }
 
-template <typename K, typename V>
-void Treemap<K, V>::Remove(std::unique_ptr<Node>& n, const K& key) {
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::Remove(const K& key) {
+  Node *n = FindNode(key);
   // If key not found, throw error
   if (!n)
     throw std::invalid_argument("Invalid  key");
 
-  // If input key is less than node move left
-  if (key < n->key) {
-    Remove(n->left, key);
-  // If input key is greater than node move right
-  } else if (key > n->key) {
-    Remove(n->right, key);
-  // Otherwise, we have found the node to remove
-  } else {
-    if (n->left && n->right) {
-    // If two children: replace with min node in right subtree
-      n->key = Min(n->right.get())->key;
-      Remove(n->right, n->key);
+  Node *rebalance_from;
+  if (n->left && n->right) {
+    // If two children: the min node of the right subtree (which has no
+    // left child) is unlinked and takes the place of the removed node
+    Node *successor = Min(n->right);
+    if (successor->parent == n) {
+      rebalance_from = successor;
     } else {
-    // If remaining node is on right, move to left
-       n = std::move((n->left) ? n->left : n->right);
-       cur_size--;
-      }
+      rebalance_from = successor->parent;
+      Replace(successor, successor->right);
+      successor->right = n->right;
+      successor->right->parent = successor;
+    }
+    Replace(n, successor);
+    successor->left = n->left;
+    successor->left->parent = successor;
+  } else {
+    // Otherwise the only child (if any) moves up into its place
+    rebalance_from = n->parent;
+    Replace(n, n->left ? n->left : n->right);
   }
+  UnindexNode(n);
+  UnindexKey(n);
+  DeleteNode(n);
+  cur_size--;
+  Rebalance(rebalance_from);
 }
-template <typename K, typename V>
-const V& Treemap<K, V>::Get(const K& key) {
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+const V& Treemap<K, V, A, C, Alloc>::Get(const K& key) {
+  return Get<K>(key);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+const V& Treemap<K, V, A, C, Alloc>::Get(const Q& key) {
   if (Empty()) {
     throw std::underflow_error("Empty tree");
   }
-  Node *n = root.get();
-  while (n) {
-    // Found the node to get
-    if (key == n->key)
-      return n->value;
-    // If input key is less than node, move left
-    if (key < n->key)
-      n = n->left.get();
-    // Otherwise, input key is greater than node and moves right
-    else
-      n = n->right.get();
-  }
-  throw std::invalid_argument("Invalid  key");
+  Node *n = FindNode(key);
+  if (!n)
+    throw std::invalid_argument("Invalid  key");
+  return n->entry.second;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+const K& Treemap<K, V, A, C, Alloc>::FloorKey(const K& key) {
+  return FloorKey<K>(key);
 }
 
-template <typename K, typename V>
-const K& Treemap<K, V>::FloorKey(const K& key) {
-  // n and floor are both set to point to root
-  Node *n = root.get();
-  Node *floor = root.get();
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+const K& Treemap<K, V, A, C, Alloc>::FloorKey(const Q& key) {
   if (Empty())
     throw std::underflow_error("Empty tree");
-  if (key < MinKey())
+  Node *floor = FloorNode(key, false);
+  if (!floor)
     throw std::out_of_range("Out of range!");
-  while (n) {
-    // If node is == to key, floor is found
-    if (key == n->key) {
-      return n->key;
-    }
-    // If node is less than the floor
-    // Current node becomes the new floor
-    if (n->key < floor->key) {
-        floor = n;
-    }
-    // If key is less than node, move left
-    if (key < n->key) {
-      n = n->left.get();
-    // Otherwise, if key is greater than node,
-    // move right and set set floor equal to
-    // the current node
-    } else {
-        floor = n;
-        n = n->right.get();
-      }
-  }
-  return floor->key;
+  return floor->entry.first;
 }
 
-template <typename K, typename V>
-const K& Treemap<K, V>::CeilKey(const K& key) {
+template <typename K, typename V, typename A, typename C, typename Alloc>
+const K& Treemap<K, V, A, C, Alloc>::CeilKey(const K& key) {
+  return CeilKey<K>(key);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+const K& Treemap<K, V, A, C, Alloc>::CeilKey(const Q& key) {
   if (Empty())
     throw std::underflow_error("Empty tree");
-  Node *n = root.get();
-  Node *ceil = root.get();
-  if (key > MaxKey())
+  Node *ceil = CeilNode(key, false);
+  if (!ceil)
     throw std::out_of_range("Out of range!");
-  while (n) {
-      // If node is == to key, ceiling is found
-    if (key == n->key)
-      return n->key;
-    // If node is greater than the ceiling
-    // Current node becomes the new ceiling
-    if (n->key > ceil->key)
-        ceil = n;
-    // If key is greater than node, move right
-    if (key > n->key) {
-      n = n->right.get();
-    // Otherwise, if key is less than node,
-    // move left and set set ceiling equal to
-    // the current node
-    } else {
-        ceil = n;
-        n = n->left.get();
-    }
-  }
-  return ceil->key;
+  return ceil->entry.first;
 }
 
-template <typename K, typename V>
-bool Treemap<K, V>::ContainsKey(const K& key) {
-  Node *n = root.get();
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Entry*
+Treemap<K, V, A, C, Alloc>::Find(const K& key) {
+  return Find<K>(key);
+}
 
-  while (n) {
-    // If key == node, key exists
-    if (key == n->key)
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+typename Treemap<K, V, A, C, Alloc>::Entry*
+Treemap<K, V, A, C, Alloc>::Find(const Q& key) {
+  return EntryOf(FindNode(key));
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Entry*
+Treemap<K, V, A, C, Alloc>::FloorEntry(const K& key) {
+  return FloorEntry<K>(key);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+typename Treemap<K, V, A, C, Alloc>::Entry*
+Treemap<K, V, A, C, Alloc>::FloorEntry(const Q& key) {
+  return EntryOf(FloorNode(key, false));
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Entry*
+Treemap<K, V, A, C, Alloc>::CeilEntry(const K& key) {
+  return CeilEntry<K>(key);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+typename Treemap<K, V, A, C, Alloc>::Entry*
+Treemap<K, V, A, C, Alloc>::CeilEntry(const Q& key) {
+  return EntryOf(CeilNode(key, false));
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Entry*
+Treemap<K, V, A, C, Alloc>::LowerEntry(const K& key) {
+  return LowerEntry<K>(key);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+typename Treemap<K, V, A, C, Alloc>::Entry*
+Treemap<K, V, A, C, Alloc>::LowerEntry(const Q& key) {
+  return EntryOf(FloorNode(key, true));
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Entry*
+Treemap<K, V, A, C, Alloc>::HigherEntry(const K& key) {
+  return HigherEntry<K>(key);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+typename Treemap<K, V, A, C, Alloc>::Entry*
+Treemap<K, V, A, C, Alloc>::HigherEntry(const Q& key) {
+  return EntryOf(CeilNode(key, true));
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename
+Treemap<K, V, A, C, Alloc>::Entry* Treemap<K, V, A, C, Alloc>::MinEntry() {
+  return EntryOf(root ? Min(root) : nullptr);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename
+Treemap<K, V, A, C, Alloc>::Entry* Treemap<K, V, A, C, Alloc>::MaxEntry() {
+  return EntryOf(root ? Max(root) : nullptr);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+bool Treemap<K, V, A, C, Alloc>::ContainsKey(const K& key) {
+  return ContainsKey<K>(key);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q, typename>
+bool Treemap<K, V, A, C, Alloc>::ContainsKey(const Q& key) {
+  return FindNode(key) != nullptr;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+bool Treemap<K, V, A, C, Alloc>::ContainsValue(const V& value) {
+  if (value_index) {
+    // Only the nodes whose value hashes the same need comparing
+    auto candidates = value_index->equal_range(ValueHasher<V>()(value));
+    for (auto it = candidates.first; it != candidates.second; ++it) {
+      if (it->second->entry.second == value)
+        return true;
+    }
+    return false;
+  }
+  for (auto& entry : *this) {
+    if (entry.second == value)
       return true;
-    // If key is less than node, move left
-    if (key < n->key)
-      n = n->left.get();
-    // Otherwise, if key is greater than node, move right
-    else
-      n = n->right.get();
   }
   return false;
 }
 
-template <typename K, typename V>
-bool Treemap<K, V>::ContainsValue(const V& value) {
-  std::queue<Node*> queue;
-  queue.push(root.get());
-  while (!queue.empty()) {
-    // Reads from the front of the queue
-    Node *n = queue.front();
-    queue.pop();
-    // If the node's value == input value, value is found
-    if (n->value == value) {
-      return true;
-    // Otherwise push left and right children onto queue
-    } else {
-      if (n->left) {
-        queue.push(n->left.get());
-      }
-      if (n->right) {
-        queue.push(n->right.get());
-      }
+template <typename K, typename V, typename A, typename C, typename Alloc>
+std::vector<K> Treemap<K, V, A, C, Alloc>::KeysForValue(const V& value) {
+  std::vector<K> keys;
+  if (value_index) {
+    auto candidates = value_index->equal_range(ValueHasher<V>()(value));
+    for (auto it = candidates.first; it != candidates.second; ++it) {
+      if (it->second->entry.second == value)
+        keys.push_back(it->second->entry.first);
     }
+    std::sort(keys.begin(), keys.end(), comp);
+    return keys;
   }
-  return false;
+  for (auto& entry : *this) {
+    if (entry.second == value)
+      keys.push_back(entry.first);
+  }
+  return keys;
 }
 
-// Private Helper Functions
-template <typename K, typename V>
-const K& Treemap<K, V>::MaxKey() {
-  if (Empty())
-    throw std::underflow_error("Empty tree");
-  return Max(root.get())->key;
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::IndexValues(bool enable) {
+  if (!enable) {
+    value_index.reset();
+    return;
+  }
+  if (!ValueHasher<V>::kHashable)
+    throw std::logic_error("Values are not hashable");
+  if (value_index)
+    return;
+  value_index.reset(new ValueIndex());
+  value_index->reserve(cur_size);
+  for (Node *n = root ? Min(root) : nullptr; n; n = Next(n))
+    IndexNode(n);
 }
 
-template <typename K, typename V>
-typename Treemap<K, V>::Node* Treemap<K, V>::Max(Node *n) {
-  if (n->right)
-    return Max(n->right.get());
-  else
-    return n;
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::IndexNode(Node *n) {
+  if (value_index)
+    value_index->emplace(ValueHasher<V>()(n->entry.second), n);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::UnindexNode(Node *n) {
+  if (!value_index)
+    return;
+  auto candidates = value_index->equal_range(
+      ValueHasher<V>()(n->entry.second));
+  for (auto it = candidates.first; it != candidates.second; ++it) {
+    if (it->second == n) {
+      value_index->erase(it);
+      return;
+    }
+  }
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::IndexKeys(bool enable) {
+  if (!enable) {
+    key_index.reset();
+    return;
+  }
+  if (!ValueHasher<K>::kHashable)
+    throw std::logic_error("Keys are not hashable");
+  if (key_index)
+    return;
+  key_index.reset(new KeyIndex());
+  ResizeKeyIndex(cur_size);
+  for (Node *n = root ? Min(root) : nullptr; n; n = Next(n))
+    IndexKey(n);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+size_t Treemap<K, V, A, C, Alloc>::KeySlotHash(const K& key) {
+  // Multiplicative (Fibonacci) hashing, folding the high bits down
+  uint64_t hash = ValueHasher<K>()(key) * 0x9E3779B97F4A7C15ull;
+  return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Node*
+Treemap<K, V, A, C, Alloc>::FindIndexedNode(const K& key) {
+  const std::vector<KeySlot>& slots = key_index->slots;
+  size_t mask = slots.size() - 1;
+  size_t hash = KeySlotHash(key);
+  // Keys are only compared when the hashes match
+  for (size_t i = hash & mask; slots[i].node; i = (i + 1) & mask) {
+    const K& slot_key = slots[i].node->entry.first;
+    if (slots[i].hash == hash && !comp(key, slot_key) &&
+        !comp(slot_key, key))
+      return slots[i].node;
+  }
+  return nullptr;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::IndexKey(Node *n) {
+  if (!key_index)
+    return;
+  // Keep at least half of the slots free, so probe runs stay short
+  if (2 * (key_index->count + 1) > key_index->slots.size())
+    ResizeKeyIndex(key_index->count + 1);
+  std::vector<KeySlot>& slots = key_index->slots;
+  size_t mask = slots.size() - 1;
+  size_t hash = KeySlotHash(n->entry.first);
+  size_t i = hash & mask;
+  while (slots[i].node)
+    i = (i + 1) & mask;
+  slots[i].hash = hash;
+  slots[i].node = n;
+  key_index->count++;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::UnindexKey(Node *n) {
+  if (!key_index)
+    return;
+  std::vector<KeySlot>& slots = key_index->slots;
+  size_t mask = slots.size() - 1;
+  size_t i = KeySlotHash(n->entry.first) & mask;
+  while (slots[i].node != n)
+    i = (i + 1) & mask;
+  // Backward shift: later slots of the probe run move into the hole when
+  // their home slot is not between the hole and them, so that lookups
+  // never stop early at a free slot (and no tombstones are needed)
+  for (size_t j = (i + 1) & mask; slots[j].node; j = (j + 1) & mask) {
+    size_t home = slots[j].hash & mask;
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      slots[i] = slots[j];
+      i = j;
+    }
+  }
+  slots[i].node = nullptr;
+  key_index->count--;
 }
 
-template <typename K, typename V>
-const K& Treemap<K, V>::MinKey() {
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::ResizeKeyIndex(size_t count) {
+  size_t num_slots = kMinKeySlots;
+  while (num_slots < 2 * count)
+    num_slots *= 2;
+  std::vector<KeySlot> old_slots(num_slots);
+  old_slots.swap(key_index->slots);
+  size_t mask = num_slots - 1;
+  for (const KeySlot& slot : old_slots) {
+    if (!slot.node)
+      continue;
+    size_t i = slot.hash & mask;
+    while (key_index->slots[i].node)
+      i = (i + 1) & mask;
+    key_index->slots[i] = slot;
+  }
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+const K& Treemap<K, V, A, C, Alloc>::MaxKey() {
+  if (Empty())
+    throw std::underflow_error("Empty tree");
+  return Max(root)->entry.first;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+const K& Treemap<K, V, A, C, Alloc>::MinKey() {
   if (Empty()) {
     throw std::underflow_error("Empty tree");
   }
-  return Min(root.get())->key;
+  return Min(root)->entry.first;
+}
+
+// Private Helper Functions
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename
+Treemap<K, V, A, C, Alloc>::Node* Treemap<K, V, A, C, Alloc>::Max(Node *n) {
+  while (n->right)
+    n = n->right;
+  return n;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename
+Treemap<K, V, A, C, Alloc>::Node* Treemap<K, V, A, C, Alloc>::Min(Node *n) {
+  while (n->left)
+    n = n->left;
+  return n;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename
+Treemap<K, V, A, C, Alloc>::Node* Treemap<K, V, A, C, Alloc>::Next(Node *n) {
+  // Successor is the min of the right subtree if any, otherwise the first
+  // ancestor reached from its left subtree
+  if (n->right)
+    return Min(n->right);
+  while (n->parent && n->parent->right == n)
+    n = n->parent;
+  return n->parent;
 }
 
-template <typename K, typename V>
-typename Treemap<K, V>::Node* Treemap<K, V>::Min(Node *n) {
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename
+Treemap<K, V, A, C, Alloc>::Node* Treemap<K, V, A, C, Alloc>::Prev(Node *n) {
+  // Mirror image of Next
   if (n->left)
-    return Min(n->left.get());
+    return Max(n->left);
+  while (n->parent && n->parent->left == n)
+    n = n->parent;
+  return n->parent;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Node* Treemap<K, V, A, C, Alloc>::NewNode(
+    const K& key, const V& value, Node *parent) {
+  Node *n = NodeTraits::allocate(node_alloc, 1);
+  try {
+    NodeTraits::construct(node_alloc, n, key, value, parent);
+  } catch (...) {
+    NodeTraits::deallocate(node_alloc, n, 1);
+    throw;
+  }
+  return n;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::DeleteNode(Node *n) {
+  NodeTraits::destroy(node_alloc, n);
+  NodeTraits::deallocate(node_alloc, n, 1);
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q>
+typename Treemap<K, V, A, C, Alloc>::Node*
+Treemap<K, V, A, C, Alloc>::FindNode(const Q& key) {
+  if constexpr (std::is_same<Q, K>::value) {
+    if (key_index)
+      return FindIndexedNode(key);
+  }
+  Node *n = root;
+  while (n) {
+    // If input key is less than node, move left
+    if (comp(key, n->entry.first))
+      n = n->left;
+    // If input key is greater than node, move right
+    else if (comp(n->entry.first, key))
+      n = n->right;
+    // Otherwise, found the node
+    else
+      return n;
+  }
+  return nullptr;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q>
+typename Treemap<K, V, A, C, Alloc>::Node*
+Treemap<K, V, A, C, Alloc>::FloorNode(const Q& key, bool strict) {
+  Node *n = root;
+  Node *floor = nullptr;
+  while (n) {
+    // If node is a candidate, a closer one can only be on its right
+    if (strict ? comp(n->entry.first, key) : !comp(key, n->entry.first)) {
+      floor = n;
+      n = n->right;
+    // Otherwise the floor is on the left
+    } else {
+      n = n->left;
+    }
+  }
+  return floor;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+template <typename Q>
+typename Treemap<K, V, A, C, Alloc>::Node*
+Treemap<K, V, A, C, Alloc>::CeilNode(const Q& key, bool strict) {
+  Node *n = root;
+  Node *ceil = nullptr;
+  while (n) {
+    // If node is a candidate, a closer one can only be on its left
+    if (strict ? comp(key, n->entry.first) : !comp(n->entry.first, key)) {
+      ceil = n;
+      n = n->left;
+    // Otherwise the ceiling is on the right
+    } else {
+      n = n->right;
+    }
+  }
+  return ceil;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::Update(Node *n) {
+  n->height = 1 + std::max(HeightOf(n->left), HeightOf(n->right));
+  n->size = 1 + SizeOf(n->left) + SizeOf(n->right);
+  n->agg = A::Combine(A::Combine(AggregateOf(n->left), EntryAggregate(n)),
+      AggregateOf(n->right));
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::Replace(Node *n, Node *child) {
+  if (child)
+    child->parent = n->parent;
+  if (!n->parent)
+    root = child;
+  else if (n->parent->left == n)
+    n->parent->left = child;
   else
-    return n;
+    n->parent->right = child;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Node*
+Treemap<K, V, A, C, Alloc>::RotateLeft(Node *n) {
+  // The right child r takes the place of n, n becomes r's left child
+  // and r's former left subtree becomes n's right subtree
+  Node *r = n->right;
+  n->right = r->left;
+  if (r->left)
+    r->left->parent = n;
+  Replace(n, r);
+  r->left = n;
+  n->parent = r;
+  Update(n);
+  Update(r);
+  return r;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+typename Treemap<K, V, A, C, Alloc>::Node*
+Treemap<K, V, A, C, Alloc>::RotateRight(Node *n) {
+  // Mirror image of RotateLeft
+  Node *l = n->left;
+  n->left = l->right;
+  if (l->right)
+    l->right->parent = n;
+  Replace(n, l);
+  l->right = n;
+  n->parent = l;
+  Update(n);
+  Update(l);
+  return l;
+}
+
+template <typename K, typename V, typename A, typename C, typename Alloc>
+void Treemap<K, V, A, C, Alloc>::Rebalance(Node *n) {
+  while (n) {
+    Update(n);
+    int balance = HeightOf(n->left) - HeightOf(n->right);
+    // Left-heavy: a single right rotation, preceded by a left rotation of
+    // the left child if its own weight is on the inside (left-right case)
+    if (balance > 1) {
+      if (HeightOf(n->left->left) < HeightOf(n->left->right))
+        RotateLeft(n->left);
+      n = RotateRight(n);
+    // Right-heavy: mirror image
+    } else if (balance < -1) {
+      if (HeightOf(n->right->right) < HeightOf(n->right->left))
+        RotateRight(n->right);
+      n = RotateLeft(n);
+    }
+    n = n->parent;
+  }
 }
 
 #endif  // TREEMAP_H_
@@ -0,0 +1,570 @@
+#ifndef TREEMULTIMAP_H_
+#define TREEMULTIMAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "treemap.h"
+
+// Values sharing one key, in insertion order, along with the summary of
+// their entries, which is kept up to date as values are appended so that
+// it never has to be recomputed over the whole run
+template <typename V, typename T>
+struct ValueRun : std::vector<V> {
+  T summary;
+};
+
+// Lifts an entry policy to a run of values sharing one key: the summary of
+// a run combines the summaries of its entries, and is paired with the
+// number of entries so that counts are available alongside it
+template <typename A>
+struct RunAggregate {
+  typedef std::pair<size_t, typename A::type> type;
+  // Reads the summary cached in @run --O(1)
+  template <typename K, typename V>
+  static type Of(const K&, const ValueRun<V, typename A::type>& run) {
+    return type(run.size(), run.summary);
+  }
+  // Appends @value, whose summary is @entry, to @run
+  template <typename V>
+  static void Append(const V& value, const typename A::type& entry,
+      ValueRun<V, typename A::type>& run) {
+    run.push_back(value);
+    run.summary = run.size() == 1 ? entry : A::Combine(run.summary, entry);
+  }
+  // Recomputes the cached summary of @run from its values --O(values)
+  template <typename K, typename V>
+  static void Refresh(const K& key, ValueRun<V, typename A::type>& run) {
+    run.summary = A::Identity();
+    for (size_t i = 0; i < run.size(); i++)
+      run.summary = A::Combine(run.summary, A::Of(key, run[i]));
+  }
+  static type Identity() {
+    return type(0, A::Identity());
+  }
+  static type Combine(const type& a, const type& b) {
+    return type(a.first + b.first, A::Combine(a.second, b.second));
+  }
+};
+
+// Ordered map allowing duplicate keys.
+//
+// Equal keys share a single tree node holding the run of their values in
+// insertion order, so the tree only grows with the number of distinct keys
+// and a key's values are contiguous. Sizes, ranks and aggregates count
+// entries (key-value pairs), not distinct keys. Keys are ordered by C, as
+// in Treemap.
+template <typename K, typename V, typename A = NoAggregate,
+    typename C = std::less<K>>
+class TreeMultimap {
+ public:
+  typedef ValueRun<V, typename A::type> Values;
+  typedef Treemap<K, Values, RunAggregate<A>, C> RunMap;
+  typedef typename RunMap::Entry Run;
+  class Iterator;
+  typedef Iterator iterator;
+  typedef typename A::type Aggregate;
+
+  // Constructor/Destructor
+  TreeMultimap() = default;
+  // Orders keys with @comp
+  explicit TreeMultimap(const C& comp) : runs(comp) {}
+  TreeMultimap(const TreeMultimap&) = delete;
+  TreeMultimap& operator=(const TreeMultimap&) = delete;
+
+  // * Capacity
+  // Returns number of key-value mappings in map --O(1)
+  size_t Size();
+  // Returns true if map is empty --O(1)
+  bool Empty();
+  // Returns number of distinct keys in map --O(1)
+  size_t KeyCount();
+
+  // * Modifiers
+  // Appends @value to the values of @key --O(log N) amortized
+  void Insert(const K& key, const V& value);
+  // Remove @key and all its values from map --O(log N + values of key)
+  // Throws exception if key doesn't exists
+  void Remove(const K& key);
+  // Remove the first occurrence of @value among the values of @key
+  // --O(log N + values of key)
+  // Throws exception if there is no such mapping
+  void Remove(const K& key, const V& value);
+  // Remove all entries --O(N)
+  void Clear();
+
+  // Replace contents with the (key, value) pairs in [first, last), which
+  // must be sorted by non-decreasing key, in a single pass --O(N)
+  // Values of equal keys keep their input order
+  // Throws exception (leaving map unchanged) if keys are out of order
+  template <typename It>
+  void BuildFromSorted(It first, It last);
+  // Same as above for every pair of @range
+  template <typename R>
+  void BuildFromSorted(const R& range);
+
+  // * Lookup
+  // Return the values of @key as a [first, last) range in insertion
+  // order, empty if key doesn't exist --O(log N)
+  std::pair<const V*, const V*> EqualRange(const K& key);
+  // Return number of values of @key --O(log N)
+  size_t Count(const K& key);
+  // Return first value inserted for @key --O(log N)
+  // Throws exception if tree is empty or key doesn't exists
+  const V& Get(const K& key);
+  // Same as the Treemap methods of the same name --O(log N)
+  const K& FloorKey(const K& key);
+  const K& CeilKey(const K& key);
+  bool ContainsKey(const K& key);
+  const K& MaxKey();
+  const K& MinKey();
+  // Return whether @value is found in map --O(N), O(values of the keys
+  // mapped to it) expected with the value index
+  bool ContainsValue(const V& value);
+  // Return keys mapped to @value, once per mapping, in increasing order
+  // --O(N), O(values of those keys) expected with the value index
+  std::vector<K> KeysForValue(const V& value);
+
+  // * Value index
+  // Build (or drop) a hash index from values to the keys they are mapped
+  // to, maintained on every insert and remove. It costs about a key plus
+  // a hash per entry. --O(N)
+  // Throws exception if enabled for values std::hash doesn't support
+  void IndexValues(bool enable);
+
+  // * Run lookup
+  // Same as the Treemap entry lookups, returning the run of values of the
+  // matching key, or nullptr if none --O(log N)
+  const Run *Find(const K& key);
+  const Run *FloorEntry(const K& key);
+  const Run *CeilEntry(const K& key);
+  const Run *LowerEntry(const K& key);
+  const Run *HigherEntry(const K& key);
+  const Run *MinEntry();
+  const Run *MaxEntry();
+
+  // * Order statistics
+  // Return number of entries with a key strictly less than @key
+  // --O(log N)
+  size_t Rank(const K& key);
+  // Return the key of the @i-th smallest entry, counting from 0
+  // --O(log N)
+  // Throws exception if @i is not less than Size()
+  const K& Select(size_t i);
+  // Return number of entries with a key in [@lo, @hi] --O(log N)
+  size_t CountRange(const K& lo, const K& hi);
+
+  // * Aggregates
+  // Return summary of all entries --O(1)
+  Aggregate Total();
+  // Return summary of the entries with @lo <= key <= @hi, combined in
+  // increasing key order --O(log N)
+  Aggregate RangeAggregate(const K& lo, const K& hi);
+
+  // * Iteration
+  // Iterators visit one run (key and its values) per distinct key, in
+  // increasing key order, as const entries
+  Iterator begin();
+  Iterator end();
+
+ private:
+  // Private member variables
+  RunMap runs;
+  size_t cur_size = 0;
+  // Value hash -> key, once per entry; only allocated while enabled
+  typedef std::unordered_multimap<size_t, K> ValueIndex;
+  std::unique_ptr<ValueIndex> value_index;
+
+  // Private methods
+  // Return whether @a and @b are the same key
+  bool SameKey(const K& a, const K& b) {
+    return !runs.KeyComp()(a, b) && !runs.KeyComp()(b, a);
+  }
+  // Return the distinct keys that the value index holds under the hash of
+  // @value, in increasing order; they may include keys of other values
+  // that hash the same
+  std::vector<K> IndexedKeys(const V& value);
+  // * Helper methods for the value index
+  void IndexEntry(const K& key, const V& value);
+  void UnindexEntry(const K& key, const V& value);
+};
+
+// Read-only view of the run iterator, since modifying the values of a run
+// would leave its summary and the value index stale
+template <typename K, typename V, typename A, typename C>
+class TreeMultimap<K, V, A, C>::Iterator {
+ public:
+  typedef std::bidirectional_iterator_tag iterator_category;
+  typedef const Run value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef const Run* pointer;
+  typedef const Run& reference;
+
+  Iterator() = default;
+
+  reference operator*() const {
+    return *it;
+  }
+  pointer operator->() const {
+    return &*it;
+  }
+  Iterator& operator++() {
+    ++it;
+    return *this;
+  }
+  Iterator operator++(int) {
+    Iterator prev = *this;
+    ++it;
+    return prev;
+  }
+  Iterator& operator--() {
+    --it;
+    return *this;
+  }
+  Iterator operator--(int) {
+    Iterator next = *this;
+    --it;
+    return next;
+  }
+  bool operator==(const Iterator& other) const {
+    return it == other.it;
+  }
+  bool operator!=(const Iterator& other) const {
+    return it != other.it;
+  }
+
+ private:
+  friend class TreeMultimap;
+  explicit Iterator(typename RunMap::Iterator it) : it(it) {}
+
+  typename RunMap::Iterator it;
+};
+
+template <typename K, typename V, typename A, typename C>
+size_t TreeMultimap<K, V, A, C>::Size() {
+  return cur_size;
+}
+
+template <typename K, typename V, typename A, typename C>
+bool TreeMultimap<K, V, A, C>::Empty() {
+  return cur_size == 0;
+}
+
+template <typename K, typename V, typename A, typename C>
+size_t TreeMultimap<K, V, A, C>::KeyCount() {
+  return runs.Size();
+}
+
+template <typename K, typename V, typename A, typename C>
+void TreeMultimap<K, V, A, C>::Insert(const K& key, const V& value) {
+  // A single descent either creates the run or appends to it; either way
+  // the run's summary is updated without going over its other values
+  Aggregate entry = A::Of(key, value);
+  Values created;
+  RunAggregate<A>::Append(value, entry, created);
+  runs.Upsert(key, created, [&](Values& run) {
+    RunAggregate<A>::Append(value, entry, run);
+  });
+  IndexEntry(key, value);
+  cur_size++;
+}
+
+template <typename K, typename V, typename A, typename C>
+void TreeMultimap<K, V, A, C>::Remove(const K& key) {
+  Run *run = runs.Find(key);
+  if (!run)
+    throw std::invalid_argument("Invalid  key");
+  cur_size -= run->second.size();
+  for (const V& value : run->second)
+    UnindexEntry(key, value);
+  runs.Remove(key);
+}
+
+template <typename K, typename V, typename A, typename C>
+void TreeMultimap<K, V, A, C>::Remove(const K& key, const V& value) {
+  bool found = false;
+  bool emptied = false;
+  runs.Modify(key, [&](Values& run) {
+    auto it = std::find(run.begin(), run.end(), value);
+    if (it != run.end()) {
+      run.erase(it);
+      RunAggregate<A>::Refresh(key, run);
+      found = true;
+      emptied = run.empty();
+    }
+  });
+  if (!found)
+    throw std::invalid_argument("Invalid  key");
+  UnindexEntry(key, value);
+  if (emptied)
+    runs.Remove(key);
+  cur_size--;
+}
+
+template <typename K, typename V, typename A, typename C>
+void TreeMultimap<K, V, A, C>::Clear() {
+  runs.Clear();
+  cur_size = 0;
+  if (value_index)
+    value_index->clear();
+}
+
+template <typename K, typename V, typename A, typename C>
+template <typename It>
+void TreeMultimap<K, V, A, C>::BuildFromSorted(It first, It last) {
+  // Group equal keys into runs, then bulk load the runs
+  std::vector<std::pair<K, Values>> grouped;
+  const C& comp = runs.KeyComp();
+  size_t count = 0;
+  for (; first != last; ++first, ++count) {
+    if (!grouped.empty() && comp(first->first, grouped.back().first))
+      throw std::invalid_argument("Unsorted keys");
+    if (grouped.empty() || comp(grouped.back().first, first->first))
+      grouped.push_back(std::make_pair(first->first, Values()));
+    RunAggregate<A>::Append(first->second, A::Of(first->first,
+        first->second), grouped.back().second);
+  }
+  runs.BuildFromSorted(grouped.begin(), grouped.end());
+  cur_size = count;
+  if (value_index) {
+    value_index->clear();
+    value_index->reserve(cur_size);
+    for (auto& run : grouped) {
+      for (const V& value : run.second)
+        IndexEntry(run.first, value);
+    }
+  }
+}
+
+template <typename K, typename V, typename A, typename C>
+template <typename R>
+void TreeMultimap<K, V, A, C>::BuildFromSorted(const R& range) {
+  BuildFromSorted(std::begin(range), std::end(range));
+}
+
+template <typename K, typename V, typename A, typename C>
+std::pair<const V*, const V*> TreeMultimap<K, V, A, C>::EqualRange(
+    const K& key) {
+  Run *run = runs.Find(key);
+  if (!run)
+    return std::pair<const V*, const V*>(nullptr, nullptr);
+  const V *values = run->second.data();
+  return std::make_pair(values, values + run->second.size());
+}
+
+template <typename K, typename V, typename A, typename C>
+size_t TreeMultimap<K, V, A, C>::Count(const K& key) {
+  Run *run = runs.Find(key);
+  return run ? run->second.size() : 0;
+}
+
+template <typename K, typename V, typename A, typename C>
+const V& TreeMultimap<K, V, A, C>::Get(const K& key) {
+  return runs.Get(key).front();
+}
+
+template <typename K, typename V, typename A, typename C>
+const K& TreeMultimap<K, V, A, C>::FloorKey(const K& key) {
+  return runs.FloorKey(key);
+}
+
+template <typename K, typename V, typename A, typename C>
+const K& TreeMultimap<K, V, A, C>::CeilKey(const K& key) {
+  return runs.CeilKey(key);
+}
+
+template <typename K, typename V, typename A, typename C>
+bool TreeMultimap<K, V, A, C>::ContainsKey(const K& key) {
+  return runs.ContainsKey(key);
+}
+
+template <typename K, typename V, typename A, typename C>
+const K& TreeMultimap<K, V, A, C>::MaxKey() {
+  return runs.MaxKey();
+}
+
+template <typename K, typename V, typename A, typename C>
+const K& TreeMultimap<K, V, A, C>::MinKey() {
+  return runs.MinKey();
+}
+
+template <typename K, typename V, typename A, typename C>
+bool TreeMultimap<K, V, A, C>::ContainsValue(const V& value) {
+  if (value_index) {
+    // Only the runs of the keys indexed under the value's hash can hold it
+    for (const K& key : IndexedKeys(value)) {
+      const Run *run = runs.Find(key);
+      if (std::find(run->second.begin(), run->second.end(), value) !=
+          run->second.end())
+        return true;
+    }
+    return false;
+  }
+  for (auto& run : runs) {
+    if (std::find(run.second.begin(), run.second.end(), value) !=
+        run.second.end())
+      return true;
+  }
+  return false;
+}
+
+template <typename K, typename V, typename A, typename C>
+std::vector<K> TreeMultimap<K, V, A, C>::KeysForValue(const V& value) {
+  std::vector<K> keys;
+  if (value_index) {
+    for (const K& key : IndexedKeys(value)) {
+      const Run *run = runs.Find(key);
+      keys.insert(keys.end(), std::count(run->second.begin(),
+          run->second.end(), value), key);
+    }
+    return keys;
+  }
+  for (auto& run : runs) {
+    for (size_t i = 0; i < run.second.size(); i++) {
+      if (run.second[i] == value)
+        keys.push_back(run.first);
+    }
+  }
+  return keys;
+}
+
+template <typename K, typename V, typename A, typename C>
+void TreeMultimap<K, V, A, C>::IndexValues(bool enable) {
+  if (!enable) {
+    value_index.reset();
+    return;
+  }
+  if (!ValueHasher<V>::kHashable)
+    throw std::logic_error("Values are not hashable");
+  if (value_index)
+    return;
+  value_index.reset(new ValueIndex());
+  value_index->reserve(cur_size);
+  for (auto& run : runs) {
+    for (const V& value : run.second)
+      IndexEntry(run.first, value);
+  }
+}
+
+template <typename K, typename V, typename A, typename C>
+std::vector<K> TreeMultimap<K, V, A, C>::IndexedKeys(const V& value) {
+  std::vector<K> keys;
+  auto candidates = value_index->equal_range(ValueHasher<V>()(value));
+  for (auto it = candidates.first; it != candidates.second; ++it)
+    keys.push_back(it->second);
+  std::sort(keys.begin(), keys.end(), runs.KeyComp());
+  keys.erase(std::unique(keys.begin(), keys.end(),
+      [this](const K& a, const K& b) { return SameKey(a, b); }), keys.end());
+  return keys;
+}
+
+template <typename K, typename V, typename A, typename C>
+void TreeMultimap<K, V, A, C>::IndexEntry(const K& key, const V& value) {
+  if (value_index)
+    value_index->emplace(ValueHasher<V>()(value), key);
+}
+
+template <typename K, typename V, typename A, typename C>
+void TreeMultimap<K, V, A, C>::UnindexEntry(const K& key, const V& value) {
+  if (!value_index)
+    return;
+  auto candidates = value_index->equal_range(ValueHasher<V>()(value));
+  for (auto it = candidates.first; it != candidates.second; ++it) {
+    if (SameKey(it->second, key)) {
+      value_index->erase(it);
+      return;
+    }
+  }
+}
+
+template <typename K, typename V, typename A, typename C>
+const typename TreeMultimap<K, V, A, C>::Run *
+TreeMultimap<K, V, A, C>::Find(const K& key) {
+  return runs.Find(key);
+}
+
+template <typename K, typename V, typename A, typename C>
+const typename TreeMultimap<K, V, A, C>::Run *
+TreeMultimap<K, V, A, C>::FloorEntry(const K& key) {
+  return runs.FloorEntry(key);
+}
+
+template <typename K, typename V, typename A, typename C>
+const typename TreeMultimap<K, V, A, C>::Run *
+TreeMultimap<K, V, A, C>::CeilEntry(const K& key) {
+  return runs.CeilEntry(key);
+}
+
+template <typename K, typename V, typename A, typename C>
+const typename TreeMultimap<K, V, A, C>::Run *
+TreeMultimap<K, V, A, C>::LowerEntry(const K& key) {
+  return runs.LowerEntry(key);
+}
+
+template <typename K, typename V, typename A, typename C>
+const typename TreeMultimap<K, V, A, C>::Run *
+TreeMultimap<K, V, A, C>::HigherEntry(const K& key) {
+  return runs.HigherEntry(key);
+}
+
+template <typename K, typename V, typename A, typename C>
+const typename TreeMultimap<K, V, A, C>::Run *
+TreeMultimap<K, V, A, C>::MinEntry() {
+  return runs.MinEntry();
+}
+
+template <typename K, typename V, typename A, typename C>
+const typename TreeMultimap<K, V, A, C>::Run *
+TreeMultimap<K, V, A, C>::MaxEntry() {
+  return runs.MaxEntry();
+}
+
+template <typename K, typename V, typename A, typename C>
+size_t TreeMultimap<K, V, A, C>::Rank(const K& key) {
+  Run *lower = runs.LowerEntry(key);
+  return lower ? CountRange(runs.MinKey(), lower->first) : 0;
+}
+
+template <typename K, typename V, typename A, typename C>
+const K& TreeMultimap<K, V, A, C>::Select(size_t i) {
+  if (i >= cur_size)
+    throw std::out_of_range("Out of range!");
+  // The run holding entry i is the first whose prefix of entries, as
+  // counted by the run summaries, extends past i
+  return runs.SearchPrefix([i](const typename RunAggregate<A>::type& prefix) {
+    return prefix.first > i;
+  })->first;
+}
+
+template <typename K, typename V, typename A, typename C>
+size_t TreeMultimap<K, V, A, C>::CountRange(const K& lo, const K& hi) {
+  return runs.RangeAggregate(lo, hi).first;
+}
+
+template <typename K, typename V, typename A, typename C>
+typename TreeMultimap<K, V, A, C>::Aggregate TreeMultimap<K, V, A, C>::Total() {
+  return runs.Total().second;
+}
+
+template <typename K, typename V, typename A, typename C>
+typename TreeMultimap<K, V, A, C>::Aggregate
+TreeMultimap<K, V, A, C>::RangeAggregate(const K& lo, const K& hi) {
+  return runs.RangeAggregate(lo, hi).second;
+}
+
+template <typename K, typename V, typename A, typename C>
+typename TreeMultimap<K, V, A, C>::Iterator TreeMultimap<K, V, A, C>::begin() {
+  return Iterator(runs.begin());
+}
+
+template <typename K, typename V, typename A, typename C>
+typename TreeMultimap<K, V, A, C>::Iterator TreeMultimap<K, V, A, C>::end() {
+  return Iterator(runs.end());
+}
+
+#endif  // TREEMULTIMAP_H_
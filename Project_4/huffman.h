@@ -1,19 +1,20 @@
 #ifndef HUFFMAN_H_
 #define HUFFMAN_H_
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cctype>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 #include <stack>
 
 #include "bstream.h"
-#include "pqueue.h"
 
 class HuffmanNode {
  public:
@@ -64,10 +65,9 @@ class Huffman {
 
  private:
   // Helper methods...
-  static void RecordFrequencies(std::ifstream &ifs, PQueue<HuffmanNode*,
-      HuffmanNodePointerLess> &min_queue, int &num_chars, std::string &input);
-  static void MakeHuffmanTree(PQueue<HuffmanNode*,
-      HuffmanNodePointerLess> &min_queue);
+  static void RecordFrequencies(std::ifstream &ifs,
+      std::vector<HuffmanNode*> &leaves, int &num_chars, std::string &input);
+  static HuffmanNode* MakeHuffmanTree(std::vector<HuffmanNode*> &leaves);
   static void PreOrderTrav(HuffmanNode *n, std::vector<std::string> &code_table,
       std::string &path, BinaryOutputStream &bos,
       bool is_root, bool is_right_child);
@@ -86,28 +86,27 @@ class Huffman {
 // To be completed below
 
 void Huffman::Compress(std::ifstream &ifs, std::ofstream &ofs) {
-  PQueue<HuffmanNode*, HuffmanNodePointerLess> min_queue;
+  std::vector<HuffmanNode*> leaves;
   int num_chars = 0;
   std::string input = "";
-  RecordFrequencies(ifs, min_queue, num_chars, input);
-  MakeHuffmanTree(min_queue);
+  RecordFrequencies(ifs, leaves, num_chars, input);
+  HuffmanNode *root = MakeHuffmanTree(leaves);
   BinaryOutputStream bos(ofs);
   std::vector<std::string> code_table(128);
   std::string path;
-  PreOrderTrav(min_queue.Top(), code_table, path, bos, true, false);
+  PreOrderTrav(root, code_table, path, bos, true, false);
   bos.PutInt(num_chars);
   WriteCodeTable(code_table, input, bos);
-  HuffmanNode *root = min_queue.Top();
-  min_queue.Pop();
   DeleteTree(root);
 }
 
 // Reads through the input. Whenever a character is encountered, its value in
 // freqnecies array is incrimented by 1. The index of a char in the array is
 // its ASCII value. The number of characters is recoreded and then all the
-// characters with their frequencies are pushed to the priority queue.
-void Huffman::RecordFrequencies(std::ifstream &ifs, PQueue<HuffmanNode*,
-    HuffmanNodePointerLess> &min_queue, int &num_chars, std::string &input) {
+// characters with their frequencies are made into leaves, sorted by
+// increasing frequency.
+void Huffman::RecordFrequencies(std::ifstream &ifs,
+    std::vector<HuffmanNode*> &leaves, int &num_chars, std::string &input) {
   int frequencies[128] = {0};
   char next_char;
   while (ifs.get(next_char)) {
@@ -118,26 +117,48 @@ void Huffman::RecordFrequencies(std::ifstream &ifs, PQueue<HuffmanNode*,
 
   for (int i = 0; i < 128; ++i) {
     if (frequencies[i] > 0)
-      min_queue.Push(new HuffmanNode(i, frequencies[i]));
+      leaves.push_back(new HuffmanNode(i, frequencies[i]));
   }
+  std::sort(leaves.begin(), leaves.end(), HuffmanNodePointerLess());
   ifs.close();
 }
 
-// Pops off the first 2 nodes from the min queue of pointers to HuffmanNodes,
-// makes them the children of a new node, and pushes the new parent node to
-// the priority queue. This is repeated until the prioirity queue only has one
-// node pointer in it (the root).
-void Huffman::MakeHuffmanTree(PQueue<HuffmanNode*,
-    HuffmanNodePointerLess> &min_queue) {
-  while (min_queue.Size() > 1) {
-    HuffmanNode *left_child(min_queue.Top());
-    min_queue.Pop();
-    HuffmanNode *right_child(min_queue.Top());
-    min_queue.Pop();
-    min_queue.Push(new HuffmanNode(0,
+// Two-queue construction for leaves already sorted by frequency. Parents are
+// created in non-decreasing frequency order, so they can be appended to a
+// second queue that stays sorted as well; the two smallest nodes are then
+// always at the fronts of the two queues, which builds the tree in linear
+// time without any heap operations. Returns the root.
+// Parents of equal frequency are taken in creation order, where a heap
+// would take them in whatever order it happens to hold them, so the tree
+// (and the zap file) may differ from one built with a priority queue. It
+// is just as short, and is decoded the same way, since zap files store
+// their tree.
+HuffmanNode* Huffman::MakeHuffmanTree(std::vector<HuffmanNode*> &leaves) {
+  if (leaves.empty())
+    throw std::underflow_error("Empty priority queue!");
+
+  std::vector<HuffmanNode*> parents;
+  parents.reserve(leaves.size() - 1);
+  size_t next_leaf = 0;
+  size_t next_parent = 0;
+  // Takes the smaller front of the two queues, ordered as HuffmanNode
+  // orders them (parents win ties with leaves as their character is 0)
+  auto take_min = [&]() {
+    if (next_parent == parents.size() ||
+        (next_leaf < leaves.size() &&
+         *leaves[next_leaf] < *parents[next_parent]))
+      return leaves[next_leaf++];
+    return parents[next_parent++];
+  };
+
+  for (size_t i = 1; i < leaves.size(); ++i) {
+    HuffmanNode *left_child = take_min();
+    HuffmanNode *right_child = take_min();
+    parents.push_back(new HuffmanNode(0,
         left_child->freq() + right_child->freq(),
         left_child, right_child));
   }
+  return parents.empty() ? leaves[0] : parents.back();
 }
 
 // Traverses the tree with pre order traversal. When it encoutners a leaf, it
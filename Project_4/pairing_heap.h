@@ -0,0 +1,260 @@
+#ifndef PAIRING_HEAP_H_
+#define PAIRING_HEAP_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Mergeable priority queue with the same interface and comparator template
+// parameter as PQueue.
+//
+// Each node keeps its leftmost child and next sibling; linking two heaps
+// just makes the lesser root a child of the other, so Push and Meld are
+// O(1) and Pop is O(log N) amortized (two-pass pairing). Nodes come from a
+// pool of geometrically growing chunks with a free list, so steady-state
+// push/pop traffic never reaches the allocator, and melding hands the
+// other heap's chunks over instead of copying its items.
+template <typename T, typename C = std::less<T>>
+class PairingHeap {
+ public:
+  // Constructor
+  PairingHeap() {}
+  // Destructor
+  ~PairingHeap();
+  PairingHeap(const PairingHeap&) = delete;
+  PairingHeap& operator=(const PairingHeap&) = delete;
+
+  // * Capacity
+  // Return number of items in priority queue
+  size_t Size();
+
+  // * Element Access
+  // Return top of priority queue
+  T& Top();
+
+  // * Modifiers
+  // Remove top of priority queue
+  void Pop();
+  // Insert item
+  void Push(const T &item);
+  // Move every item of @other into this queue, leaving @other empty
+  // O(1) for the items, plus O(log N) to hand over the node chunks
+  void Meld(PairingHeap &other);
+
+ private:
+  // Private types
+  struct Node {
+    explicit Node(const T &item) : item(item) {}
+    T item;
+    Node *child = nullptr;
+    Node *sibling = nullptr;
+  };
+  // A pooled slot holds either a live node or a link in the free list
+  struct FreeSlot {
+    FreeSlot *next;
+  };
+  typedef typename std::aligned_storage<sizeof(Node),
+      alignof(Node)>::type Slot;
+
+  // Private constants
+  static const size_t kMinChunkSize = 16;
+
+  // Private member variables
+  Node *root = nullptr;
+  size_t cur_size = 0;
+  C cmp;
+
+  // Node pool: owned chunks, a free list of released slots, and the
+  // untouched remainder of the newest chunk
+  std::vector<std::unique_ptr<Slot[]>> chunks;
+  size_t pool_capacity = 0;
+  FreeSlot *free_head = nullptr;
+  FreeSlot *free_tail = nullptr;
+  Slot *bump_next = nullptr;
+  Slot *bump_end = nullptr;
+
+  // Private methods
+  // Makes the lower priority root the leftmost child of the other
+  Node* Link(Node *a, Node *b);
+  // Combines a list of sibling subtrees into a single heap
+  Node* MergePairs(Node *first);
+
+  // * Helper methods for the node pool
+  Node* NewNode(const T &item);
+  void FreeNode(Node *n);
+  // Returns an unused @slot to the free list
+  void ReleaseSlot(void *slot);
+};
+
+template <typename T, typename C>
+PairingHeap<T, C>::~PairingHeap() {
+  // Destroy live items; the chunks release the memory afterwards
+  std::vector<Node*> stack;
+  if (root)
+    stack.push_back(root);
+  while (!stack.empty()) {
+    Node *n = stack.back();
+    stack.pop_back();
+    if (n->child)
+      stack.push_back(n->child);
+    if (n->sibling)
+      stack.push_back(n->sibling);
+    n->~Node();
+  }
+}
+
+template <typename T, typename C>
+size_t PairingHeap<T, C>::Size() {
+  return cur_size;
+}
+
+template <typename T, typename C>
+T& PairingHeap<T, C>::Top() {
+  if (!Size())
+    throw std::underflow_error("Empty priority queue!");
+  return root->item;
+}
+
+template <typename T, typename C>
+void PairingHeap<T, C>::Push(const T &item) {
+  Node *n = NewNode(item);
+  root = root ? Link(root, n) : n;
+  cur_size++;
+}
+
+template <typename T, typename C>
+void PairingHeap<T, C>::Pop() {
+  if (!Size())
+    throw std::underflow_error("Empty priority queue!");
+  Node *old_root = root;
+  root = MergePairs(root->child);
+  FreeNode(old_root);
+  cur_size--;
+}
+
+template <typename T, typename C>
+void PairingHeap<T, C>::Meld(PairingHeap &other) {
+  if (this == &other || !other.pool_capacity)
+    return;
+
+  // Items: a single link of the two roots
+  if (other.root)
+    root = root ? Link(root, other.root) : other.root;
+  cur_size += other.cur_size;
+
+  // Memory: take ownership of the other pool's chunks and free slots
+  for (size_t i = 0; i < other.chunks.size(); i++)
+    chunks.push_back(std::move(other.chunks[i]));
+  pool_capacity += other.pool_capacity;
+  if (other.free_head) {
+    if (free_tail)
+      free_tail->next = other.free_head;
+    else
+      free_head = other.free_head;
+    free_tail = other.free_tail;
+  }
+  // Only one bump region can be kept; keep the larger one (the other
+  // slots stay owned by this heap and are released with it)
+  if (other.bump_end - other.bump_next > bump_end - bump_next) {
+    bump_next = other.bump_next;
+    bump_end = other.bump_end;
+  }
+
+  other.root = nullptr;
+  other.cur_size = 0;
+  other.chunks.clear();
+  other.pool_capacity = 0;
+  other.free_head = other.free_tail = nullptr;
+  other.bump_next = other.bump_end = nullptr;
+}
+
+template <typename T, typename C>
+typename PairingHeap<T, C>::Node* PairingHeap<T, C>::Link(Node *a, Node *b) {
+  if (cmp(b->item, a->item))
+    std::swap(a, b);
+  b->sibling = a->child;
+  a->child = b;
+  return a;
+}
+
+template <typename T, typename C>
+typename PairingHeap<T, C>::Node* PairingHeap<T, C>::MergePairs(Node *first) {
+  // First pass: link siblings two by two from left to right, stacking the
+  // results (through their sibling pointers) so they come out reversed
+  Node *pairs = nullptr;
+  while (first) {
+    Node *a = first;
+    Node *b = a->sibling;
+    if (!b) {
+      a->sibling = pairs;
+      pairs = a;
+      break;
+    }
+    first = b->sibling;
+    a->sibling = b->sibling = nullptr;
+    Node *linked = Link(a, b);
+    linked->sibling = pairs;
+    pairs = linked;
+  }
+
+  // Second pass: link the pairs into one heap from right to left
+  Node *result = nullptr;
+  while (pairs) {
+    Node *next = pairs->sibling;
+    pairs->sibling = nullptr;
+    result = result ? Link(result, pairs) : pairs;
+    pairs = next;
+  }
+  return result;
+}
+
+template <typename T, typename C>
+typename PairingHeap<T, C>::Node* PairingHeap<T, C>::NewNode(const T &item) {
+  void *slot;
+  if (free_head) {
+    slot = free_head;
+    free_head = free_head->next;
+    if (!free_head)
+      free_tail = nullptr;
+  } else {
+    if (bump_next == bump_end) {
+      // Grow the pool geometrically so the number of chunks (and thus the
+      // cost of melding) stays logarithmic in the number of nodes
+      size_t chunk_size = pool_capacity;
+      if (chunk_size < kMinChunkSize)
+        chunk_size = kMinChunkSize;
+      chunks.push_back(std::unique_ptr<Slot[]>(new Slot[chunk_size]));
+      pool_capacity += chunk_size;
+      bump_next = chunks.back().get();
+      bump_end = bump_next + chunk_size;
+    }
+    slot = bump_next++;
+  }
+  try {
+    return new (slot) Node(item);
+  } catch (...) {
+    ReleaseSlot(slot);
+    throw;
+  }
+}
+
+template <typename T, typename C>
+void PairingHeap<T, C>::FreeNode(Node *n) {
+  n->~Node();
+  ReleaseSlot(n);
+}
+
+template <typename T, typename C>
+void PairingHeap<T, C>::ReleaseSlot(void *slot) {
+  FreeSlot *released = new (slot) FreeSlot{ free_head };
+  free_head = released;
+  if (!free_tail)
+    free_tail = released;
+}
+
+#endif  // PAIRING_HEAP_H_
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <cassert>
 #include <functional>
+#include <iterator>
 #include <vector>
 #include <stdexcept>
 #include <utility>
@@ -36,6 +37,19 @@ class PQueue {
   // Insert item and sort priority queue
   void Push(const T &item);
 
+  // * Batch modifiers
+  // Insert every item in [first, last), then restore the heap only along
+  // the paths above the new items (cheaper than one percolate per item)
+  template <typename It>
+  void PushBatch(It first, It last);
+  // Insert every item of @range
+  template <typename R>
+  void PushBatch(const R &range);
+  // Remove up to @k top items in priority order, writing them to @out.
+  // Returns the number of items removed (less than @k if queue runs out)
+  template <typename Out>
+  size_t PopK(size_t k, Out out);
+
  private:
   // Private member variables
   std::vector<T> items;
@@ -80,6 +94,9 @@ class PQueue {
   // descendents until the node is correctly placed
   void PercolateDown(size_t n);
 
+  // Rebuilds heap order over the subtrees holding items [first, Size())
+  void Reheapify(size_t first);
+
   // Recieves comparator from user and compares two values
   bool CompareNodes(size_t i, size_t j);
 };
@@ -144,6 +161,71 @@ void PQueue<T, C>::PercolateDown(size_t n) {
   }
 }
 
+template <typename T, typename C>
+template <typename It>
+void PQueue<T, C>::PushBatch(It first, It last) {
+  size_t old_size = cur_size;
+  items.insert(items.end(), first, last);
+  cur_size = items.size();
+  size_t added = cur_size - old_size;
+  if (!added)
+    return;
+
+  // Percolating each item up costs up to log(N) swaps per item, while
+  // reheapifying the touched subtrees costs about 2 swaps per item plus
+  // one log(N) percolation per ancestor level; pick the cheaper bound
+  size_t log_size = 0;
+  for (size_t n = cur_size; n > 1; n /= 2)
+    log_size++;
+  if (added * log_size <= 2 * added + log_size * log_size) {
+    for (size_t n = old_size; n < cur_size; n++)
+      PercolateUp(n);
+  } else {
+    Reheapify(old_size);
+  }
+}
+
+template <typename T, typename C>
+template <typename R>
+void PQueue<T, C>::PushBatch(const R &range) {
+  PushBatch(std::begin(range), std::end(range));
+}
+
+template <typename T, typename C>
+void PQueue<T, C>::Reheapify(size_t first) {
+  if (cur_size < 2)
+    return;
+  // Only the parents of new items and their ancestors can violate heap
+  // order. Walk those index ranges level by level from the bottom up,
+  // percolating each one down (Floyd's heap construction, restricted)
+  size_t lo = (first == Root()) ? Root() : Parent(first);
+  size_t hi = Parent(cur_size - 1);
+  while (true) {
+    for (size_t n = hi + 1; n-- > lo;)
+      PercolateDown(n);
+    if (lo == Root())
+      break;
+    lo = Parent(lo);
+    hi = Parent(hi);
+  }
+}
+
+template <typename T, typename C>
+template <typename Out>
+size_t PQueue<T, C>::PopK(size_t k, Out out) {
+  // Single bounds check for the whole batch rather than one per Top/Pop
+  size_t count = std::min(k, cur_size);
+  for (size_t i = 0; i < count; i++) {
+    *out++ = std::move(items[Root()]);
+    if (cur_size > 1)
+      items[Root()] = std::move(items[cur_size - 1]);
+    items.pop_back();
+    cur_size--;
+    PercolateDown(Root());
+  }
+  return count;
+}
+
 // To be completed below
 
 #endif  // PQUEUE_H_
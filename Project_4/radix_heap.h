@@ -0,0 +1,115 @@
+#ifndef RADIX_HEAP_H_
+#define RADIX_HEAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Default key extractor: the item itself is its (unsigned) priority
+template <typename T>
+class RadixIdentity {
+ public:
+  size_t operator () (const T &item) const {
+    return static_cast<size_t>(item);
+  }
+};
+
+// Monotone min priority queue for unsigned integer keys.
+//
+// Items are kept in buckets by the highest bit in which their key differs
+// from the last key returned by Top(), so an item only ever moves towards
+// bucket 0 and each operation is amortized O(1) per key bit instead of the
+// O(log N) comparisons of a binary heap. In exchange, a pushed key must not
+// be smaller than the key last returned by Top(), which holds for
+// timestamps, Dijkstra distances and Huffman merge frequencies.
+template <typename T, typename K = RadixIdentity<T>>
+class RadixHeap {
+ public:
+  // Constructor
+  RadixHeap() : buckets(kNumBuckets) {}
+
+  // * Capacity
+  // Return number of items in priority queue
+  size_t Size();
+
+  // * Element Access
+  // Return item with the smallest key
+  T& Top();
+
+  // * Modifiers
+  // Remove item with the smallest key
+  void Pop();
+  // Insert item, throws if its key is below the last key returned by Top
+  void Push(const T &item);
+
+ private:
+  // Private constants
+  // One bucket per key bit, plus bucket 0 for keys equal to last
+  static const size_t kNumBuckets = sizeof(size_t) * 8 + 1;
+
+  // Private member variables
+  std::vector<std::vector<T>> buckets;
+  size_t last = 0;
+  size_t cur_size = 0;
+  K key;
+
+  // Private methods
+  // Locates the bucket of a key relative to last
+  size_t Bucket(size_t k) {
+    return k == last ? 0 : kNumBuckets - 1 - __builtin_clzl(k ^ last);
+  }
+  // Moves the smallest non-empty bucket down so that bucket 0 holds
+  // every item with the minimum key
+  void Redistribute();
+};
+
+template <typename T, typename K>
+size_t RadixHeap<T, K>::Size() {
+  return cur_size;
+}
+
+template <typename T, typename K>
+T& RadixHeap<T, K>::Top() {
+  if (!Size())
+    throw std::underflow_error("Empty priority queue!");
+  if (buckets[0].empty())
+    Redistribute();
+  return buckets[0].back();
+}
+
+template <typename T, typename K>
+void RadixHeap<T, K>::Pop() {
+  Top();
+  buckets[0].pop_back();
+  cur_size--;
+}
+
+template <typename T, typename K>
+void RadixHeap<T, K>::Push(const T &item) {
+  size_t k = key(item);
+  if (k < last)
+    throw std::invalid_argument("Key below current minimum");
+  buckets[Bucket(k)].push_back(item);
+  cur_size++;
+}
+
+template <typename T, typename K>
+void RadixHeap<T, K>::Redistribute() {
+  size_t i = 1;
+  while (buckets[i].empty())
+    i++;
+
+  // The new minimum becomes the reference key; every other item in the
+  // bucket then differs from it in a lower bit and lands in a lower bucket
+  std::vector<T> moving;
+  std::swap(moving, buckets[i]);
+  last = key(moving[0]);
+  for (size_t j = 1; j < moving.size(); j++)
+    last = std::min(last, key(moving[j]));
+  for (size_t j = 0; j < moving.size(); j++)
+    buckets[Bucket(key(moving[j]))].push_back(std::move(moving[j]));
+}
+
+#endif  // RADIX_HEAP_H_
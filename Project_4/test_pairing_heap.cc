@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include "pairing_heap.h"
+
+TEST(PairingHeap, less) {
+    PairingHeap<int> ph;
+
+    // tests with a less than comparator
+    EXPECT_THROW(ph.Pop(), std::exception);
+    EXPECT_THROW(ph.Top(), std::exception);
+    ph.Push(42);
+    ph.Push(23);
+    ph.Push(2);
+    ph.Push(34);
+
+    EXPECT_EQ(ph.Top(), 2);
+    EXPECT_EQ(ph.Size(), 4);
+    ph.Pop();
+    EXPECT_EQ(ph.Top(), 23);
+}
+
+TEST(PairingHeap, great) {
+    PairingHeap<int, std::greater<int>> ph;
+
+    // tests a long series of pushes and pops with a greater comparator,
+    // reusing pooled nodes after the first round
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 500; i++)
+            ph.Push((i * 7919) % 500);
+        for (int i = 499; i >= 0; i--) {
+            EXPECT_EQ(ph.Top(), i);
+            ph.Pop();
+        }
+        EXPECT_EQ(ph.Size(), 0);
+    }
+}
+
+TEST(PairingHeap, meld) {
+    PairingHeap<std::string> a;
+    PairingHeap<std::string> b;
+
+    // tests merging two queues, then using both afterwards
+    a.Push("delta");
+    a.Push("bravo");
+    b.Push("charlie");
+    b.Push("alpha");
+    b.Push("echo");
+    b.Pop();
+    a.Meld(b);
+    EXPECT_EQ(a.Size(), 4);
+    EXPECT_EQ(b.Size(), 0);
+    EXPECT_THROW(b.Top(), std::exception);
+
+    b.Push("zulu");
+    EXPECT_EQ(b.Top(), "zulu");
+    a.Push("foxtrot");
+    std::string order;
+    while (a.Size()) {
+        order += a.Top()[0];
+        a.Pop();
+    }
+    EXPECT_EQ(order, "bcdef");
+}
+
+TEST(PairingHeap, meld_many) {
+    PairingHeap<int> global;
+
+    // tests merging several partial results into one queue
+    for (int part = 0; part < 8; part++) {
+        PairingHeap<int> local;
+        for (int i = part; i < 800; i += 8)
+            local.Push(i);
+        global.Meld(local);
+    }
+    EXPECT_EQ(global.Size(), 800);
+    for (int i = 0; i < 800; i++) {
+        EXPECT_EQ(global.Top(), i);
+        global.Pop();
+    }
+}
+
+// Item whose copy throws while fail is set, remembering where it was
+// being built
+struct Fragile {
+    static bool fail;
+    static const void *failed_at;
+    int key;
+
+    explicit Fragile(int key) : key(key) {}
+    Fragile(const Fragile &other) : key(other.key) {
+        if (fail) {
+            failed_at = this;
+            throw std::runtime_error("copy failed");
+        }
+    }
+    bool operator<(const Fragile &other) const {
+        return key < other.key;
+    }
+};
+bool Fragile::fail = false;
+const void *Fragile::failed_at = nullptr;
+
+TEST(PairingHeap, push_throws) {
+    PairingHeap<Fragile> ph;
+
+    // tests that a failed push leaves the heap as it was and frees its slot
+    ph.Push(Fragile(5));
+    Fragile::fail = true;
+    EXPECT_THROW(ph.Push(Fragile(1)), std::runtime_error);
+    Fragile::fail = false;
+    EXPECT_EQ(ph.Size(), 1);
+    EXPECT_EQ(ph.Top().key, 5);
+    ph.Push(Fragile(2));
+    EXPECT_EQ(&ph.Top(), Fragile::failed_at);
+    EXPECT_EQ(ph.Top().key, 2);
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 
 #include <functional>
+#include <iterator>
+#include <vector>
 #include "pqueue.h"
 
 // Raj Garimella
@@ -223,6 +225,49 @@ TEST(PQueue, push_pop_push_pop) {
     EXPECT_EQ(pq.Size(), 4);
 }
 
+TEST(PQueue, push_batch) {
+    PQueue<int, std::greater<int>> pq;
+
+    // tests a small batch onto an empty queue and a large batch onto
+    // an existing queue (exercises both restructuring strategies)
+    std::vector<int> small{ 42, 23, 2, 34 };
+    pq.PushBatch(small);
+    EXPECT_EQ(pq.Top(), 42);
+    EXPECT_EQ(pq.Size(), 4);
+
+    std::vector<int> large;
+    for (int i = 0; i < 1000; i++)
+        large.push_back((i * 7919) % 1000);
+    pq.PushBatch(large.begin(), large.end());
+    EXPECT_EQ(pq.Size(), 1004);
+
+    int prev = pq.Top();
+    while (pq.Size()) {
+        EXPECT_LE(pq.Top(), prev);
+        prev = pq.Top();
+        pq.Pop();
+    }
+}
+
+TEST(PQueue, pop_k) {
+    PQueue<int> pq;
+
+    // tests extracting the k smallest items in one call
+    std::vector<int> out;
+    EXPECT_EQ(pq.PopK(3, std::back_inserter(out)), 0);
+    pq.PushBatch(std::vector<int>{ 9, 4, 7, 1, 8, 3 });
+    EXPECT_EQ(pq.PopK(4, std::back_inserter(out)), 4);
+    EXPECT_EQ(out, (std::vector<int>{ 1, 3, 4, 7 }));
+    EXPECT_EQ(pq.Size(), 2);
+    EXPECT_EQ(pq.Top(), 8);
+
+    // asking for more than available drains the queue
+    EXPECT_EQ(pq.PopK(10, std::back_inserter(out)), 2);
+    EXPECT_EQ(out.back(), 9);
+    EXPECT_EQ(pq.Size(), 0);
+    EXPECT_THROW(pq.Top(), std::exception);
+}
+
 
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
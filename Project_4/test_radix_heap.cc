@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "radix_heap.h"
+
+TEST(RadixHeap, basic) {
+    RadixHeap<unsigned> rh;
+
+    // tests ordering of unsigned keys
+    EXPECT_THROW(rh.Pop(), std::exception);
+    EXPECT_THROW(rh.Top(), std::exception);
+    rh.Push(42);
+    rh.Push(23);
+    rh.Push(2);
+    rh.Push(34);
+
+    EXPECT_EQ(rh.Top(), 2);
+    EXPECT_EQ(rh.Size(), 4);
+    rh.Pop();
+    EXPECT_EQ(rh.Top(), 23);
+}
+
+TEST(RadixHeap, monotone) {
+    RadixHeap<size_t> rh;
+
+    // tests pushes interleaved with pops, as long as keys never go
+    // below the last key returned by Top
+    rh.Push(10);
+    rh.Push(7);
+    EXPECT_EQ(rh.Top(), 7);
+    rh.Pop();
+    rh.Push(7);
+    rh.Push(8);
+    EXPECT_THROW(rh.Push(6), std::exception);
+    EXPECT_EQ(rh.Top(), 7);
+    rh.Pop();
+    EXPECT_EQ(rh.Top(), 8);
+    rh.Pop();
+    EXPECT_EQ(rh.Top(), 10);
+    rh.Pop();
+    EXPECT_EQ(rh.Size(), 0);
+}
+
+class PairFirst {
+ public:
+    size_t operator () (const std::pair<size_t, std::string> &p) const {
+        return p.first;
+    }
+};
+
+TEST(RadixHeap, key_extractor) {
+    RadixHeap<std::pair<size_t, std::string>, PairFirst> rh;
+
+    // tests items carrying a payload next to their key
+    rh.Push({ 300, "c" });
+    rh.Push({ 1, "a" });
+    rh.Push({ 1ul << 40, "d" });
+    rh.Push({ 20, "b" });
+
+    std::string order;
+    while (rh.Size()) {
+        order += rh.Top().second;
+        rh.Pop();
+    }
+    EXPECT_EQ(order, "abcd");
+}
+
+TEST(RadixHeap, many) {
+    RadixHeap<size_t> rh;
+
+    // tests a long series of pushes popping in sorted order
+    for (size_t i = 0; i < 1000; i++)
+        rh.Push((i * 7919) % 1000);
+    for (size_t i = 0; i < 1000; i++) {
+        EXPECT_EQ(rh.Top(), i);
+        rh.Pop();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}